@@ -2,23 +2,17 @@
 #define FD_READ_XLSX_HEADER_ONLY_HPP
 
 #include "fd-read-xlsx.hpp"
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
 
 namespace fd_read_xlsx {
 
 typedef std::string str_t;
 
-class Exception : public std::exception
-{
-public:
-	Exception(str_t const& msg)
-	  : msg_("fd-read-xslx library: " + msg + '.')
-	{}
-	const char* what() const throw() { return msg_.c_str(); }
-
-private:
-	str_t const msg_;
-};
-
 // Representation of a cell: std::variant of string, int64_t and double. A int64_t is choosen for
 // int: the size is like the size of a double.
 typedef std::variant<str_t, int64_t, double> cell_t;
@@ -64,26 +58,43 @@ get_attribute(str_t const& str,
 }
 // Get the file contents from the archive into a string.
 str_t
-get_contents(zip_t* archive_ptr, char const* const file_name)
+get_contents(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor)
 {
-	auto const file_ptr{ zip_fopen(archive_ptr, file_name, 0) };
+	auto const file_ptr{ zip_fopen(archive_ptr, file_name.c_str(), 0) };
 	if (!file_ptr)
-		throw Exception{ "unable to open the “" + str_t(file_name) +
+		throw Exception{ "unable to open the “" + file_name +
 			               "” workbook (or the file is not a xlsx workbook)" };
 	str_t rvo;
-	while (true) {
-		char buffer[1024];
-		auto const n{ zip_fread(file_ptr, buffer, sizeof(buffer)) };
-		if (n == 0)
-			break;
-		rvo += str_t(buffer, buffer + n);
+	try {
+		if (monitor)
+			monitor->open(archive_ptr, file_name);
+		while (true) {
+			char buffer[1024];
+			auto const n{ zip_fread(file_ptr, buffer, sizeof(buffer)) };
+			if (n < 0)
+				throw Exception{ "unable to read the “" + file_name + "” file (file corrupted?)" };
+			if (n == 0)
+				break;
+			if (monitor)
+				monitor->chunk(size_t(n));
+			rvo.append(buffer, size_t(n));
+		}
+	} catch (...) {
+		zip_fclose(file_ptr);
+		throw;
 	}
+	zip_fclose(file_ptr);
 	return rvo;
 }
 str_t
+get_contents(zip_t* archive_ptr, char const* const file_name)
+{
+	return get_contents(archive_ptr, file_name, nullptr);
+}
+str_t
 get_contents(zip_t* archive_ptr, str_t const& file_name)
 {
-	return get_contents(archive_ptr, file_name.c_str());
+	return get_contents(archive_ptr, file_name, nullptr);
 }
 void
 replace_all(str_t& str, str_t that, char c)
@@ -94,65 +105,339 @@ replace_all(str_t& str, str_t that, char c)
 		pos = str.find(that, pos + 1);
 	}
 }
-// Get the shared strings in the xml file from a Microsoft xlsx workbook.  We only concatenate the
-// text between <t ...> and </t> tags within <si> and </si> tags to populate the vector.
-std::vector<str_t>
-get_shared_strings(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace)
+void
+append_utf8(str_t& str, uint32_t u)
+{
+	if (u < 0x80)
+		str += char(u);
+	else if (u < 0x800) {
+		str += char(0xc0 | (u >> 6));
+		str += char(0x80 | (u & 0x3f));
+	} else if (u < 0x10000) {
+		str += char(0xe0 | (u >> 12));
+		str += char(0x80 | ((u >> 6) & 0x3f));
+		str += char(0x80 | (u & 0x3f));
+	} else {
+		str += char(0xf0 | (u >> 18));
+		str += char(0x80 | ((u >> 12) & 0x3f));
+		str += char(0x80 | ((u >> 6) & 0x3f));
+		str += char(0x80 | (u & 0x3f));
+	}
+}
+void
+append_entity(str_t& str, str_t const& name)
+{
+	if (name == "lt")
+		str += '<';
+	else if (name == "gt")
+		str += '>';
+	else if (name == "amp")
+		str += '&';
+	else if (name == "quot")
+		str += '"';
+	else if (name == "apos")
+		str += '\'';
+	else if ((name.size() > 1) && (name[0] == '#')) {
+		auto const hex{ (name[1] == 'x') || (name[1] == 'X') };
+		uint32_t u{};
+		bool ok{ name.size() > (hex ? 2u : 1u) };
+		for (auto it{ cbegin(name) + (hex ? 2 : 1) }; ok && (it != cend(name)); ++it) {
+			auto const c{ *it };
+			if (('0' <= c) && (c <= '9'))
+				u = (hex ? 16 : 10) * u + uint32_t(c - '0');
+			else if (hex && ('a' <= c) && (c <= 'f'))
+				u = 16 * u + uint32_t(10 + c - 'a');
+			else if (hex && ('A' <= c) && (c <= 'F'))
+				u = 16 * u + uint32_t(10 + c - 'A');
+			else
+				ok = false;
+			ok = ok && (u <= 0x10ffff);
+		}
+		if (ok)
+			append_utf8(str, u);
+		else
+			str += '&' + name + ';';
+	} else
+		str += '&' + name + ';';
+}
+str_t
+decode_entities(str_t const& text)
+{
+	auto pos{ text.find('&') };
+	if (pos == str_t::npos)
+		return text;
+	str_t rvo{ cbegin(text), cbegin(text) + pos };
+	while (pos != str_t::npos) {
+		auto const end{ text.find(';', pos) };
+		if (end == str_t::npos) {
+			rvo.append(text, pos, str_t::npos);
+			break;
+		}
+		append_entity(rvo, text.substr(pos + 1, end - pos - 1));
+		pos = text.find('&', end);
+		rvo.append(text, end + 1, pos - end - 1);
+	}
+	return rvo;
+}
+
+// Class for RAII: a buffered reader of a file of the archive, char by char.
+class ZipReader
 {
+public:
+	// The monitor, if any, is given each chunk read.
+	ZipReader(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor)
+	  : file_name_(file_name)
+	  , file_ptr_(zip_fopen(archive_ptr, file_name.c_str(), 0))
+	  , monitor_(monitor)
+	{
+		if (!file_ptr_)
+			throw Exception{ "unable to open the “" + file_name + "” file" };
+		if (monitor_)
+			try {
+				monitor_->open(archive_ptr, file_name);
+			} catch (...) {
+				zip_fclose(file_ptr_);
+				throw;
+			}
+	}
+	ZipReader(zip_t* archive_ptr, str_t const& file_name)
+	  : ZipReader(archive_ptr, file_name, nullptr)
+	{}
+	~ZipReader() { zip_fclose(file_ptr_); }
+	// Returns the next char or -1 at the end of the file.
+	int next_char()
+	{
+		if ((i_ == n_) && !fill())
+			return -1;
+		return static_cast<unsigned char>(buffer_[i_++]);
+	}
+	// Returns the rest of the file.
+	str_t read_all()
+	{
+		str_t rvo{ buffer_ + i_, buffer_ + n_ };
+		i_ = n_;
+		while (fill()) {
+			rvo.append(buffer_, n_);
+			i_ = n_;
+		}
+		return rvo;
+	}
 
-	std::vector<str_t> rvo;
+private:
+	// Read the next chunk. Returns false at the end of the file; a read error (a bad CRC or
+	// corrupted deflate data) is not the end of the file.
+	bool fill()
+	{
+		auto const n{ zip_fread(file_ptr_, buffer_, sizeof(buffer_)) };
+		if (n < 0)
+			throw Exception{ "unable to read the “" + file_name_ + "” file (file corrupted?)" };
+		n_ = size_t(n);
+		i_ = 0;
+		if (monitor_ && (n_ != 0))
+			monitor_->chunk(n_);
+		return n_ != 0;
+	}
+	str_t const file_name_;
+	zip_file_t* const file_ptr_;
+	Monitor* const monitor_;
+	char buffer_[4096];
+	size_t n_{}, i_{};
+};
 
-	// We presume that the file is not so big ; so we can get it in memory.
-	auto const contents{ get_contents(archive_ptr, file_name) };
+// Single pass parser of a shared strings part: “next_char” returns the next char of the part or -1
+// at its end. The text is decoded directly into the pool.
+template<typename NextChar>
+void
+parse_shared_strings(NextChar&& next_char,
+                     str_t const& file_name,
+                     str_t const& nmspace,
+                     SharedStrings& rvo)
+{
+	auto const prefix{ (nmspace == "") ? nmspace : (nmspace + ':') };
+	auto const si_tag{ prefix + "si" };
+	auto const t_tag{ prefix + 't' };
+	auto const rph_tag{ prefix + "rPh" };
 
-	auto const beg_si_tag{ '<' + ((nmspace == "") ? nmspace : (nmspace + ':')) + "si>" };
-	auto const end_si_tag{ "</" + ((nmspace == "") ? nmspace : (nmspace + ':')) + "si>" };
-	auto const beg_t_tag{ '<' + ((nmspace == "") ? nmspace : (nmspace + ':')) + 't' };
-	auto const end_t_tag{ "</" + ((nmspace == "") ? nmspace : (nmspace + ':')) + "t>" };
-	str_t::size_type pos{ 0 };
-	while (true) {
-		auto const pos_si_0{ contents.find(beg_si_tag, pos) };
-		if (pos_si_0 == str_t::npos)
-			break;
-		auto const pos_si_1{ contents.find(end_si_tag, pos_si_0 + beg_si_tag.size()) };
-		if (pos_si_1 == str_t::npos)
-			throw Exception{ "unable to found the “" + end_si_tag + "” string after the “" + beg_si_tag +
-				               "” tag (" + file_name + " corrupted?)" };
-		str_t str;
-		str_t::size_type pos_t{ pos_si_0 + beg_si_tag.size() };
-		while (true) {
-			auto const pos_t_0{ contents.find(beg_t_tag, pos_t) };
-			if (pos_t_0 > pos_si_1)
-				break;
-			auto const pos_t_1{ contents.find('>', pos_t_0 + beg_t_tag.size()) };
-			if (pos_t_1 == str_t::npos)
-				throw Exception{ "unable to found the '>' char after the “" + beg_t_tag + "” tag (" +
+	bool in_si{}, in_t{};
+	int in_rph{};
+	str_t tag, entity;
+	for (int c{ next_char() }; c != -1; c = next_char()) {
+		if (c == '<') {
+			// Get the tag name and skip the attributes: <name ...>, </name> or <name .../>.
+			c = next_char();
+			auto const closing{ c == '/' };
+			if (closing)
+				c = next_char();
+			tag.clear();
+			while ((c != -1) && (c != '>') && (c != '/') && (c != ' ') && (c != '\t') && (c != '\n') &&
+			       (c != '\r')) {
+				tag += char(c);
+				c = next_char();
+			}
+			int last{};
+			while ((c != -1) && (c != '>')) {
+				if ((c == '"') || (c == '\'')) {
+					auto const quote{ c };
+					do
+						c = next_char();
+					while ((c != -1) && (c != quote));
+				}
+				if ((c != ' ') && (c != '\t') && (c != '\n') && (c != '\r'))
+					last = c;
+				c = next_char();
+			}
+			if (c == -1)
+				throw Exception{ "unable to found the '>' char after the “<" + tag + "” tag (" +
 					               file_name + " corrupted?)" };
-			auto const pos_t_2{ contents.find(end_t_tag, pos_t_1 + 1) };
-			if (pos_t_2 == str_t::npos)
-				throw Exception{ "unable to found the “" + end_t_tag + "” tag after the “" + beg_t_tag +
-					               "” tag (" + file_name + " corrupted?)" };
-			str += str_t(cbegin(contents) + pos_t_1 + 1, cbegin(contents) + pos_t_2);
-			pos_t = pos_t_2 + end_t_tag.size();
+			auto const empty{ last == '/' };
+			if (tag == si_tag) {
+				if (closing && in_si)
+					rvo.push();
+				in_si = !closing && !empty;
+				if (empty)
+					rvo.push();
+			} else if (tag == t_tag)
+				in_t = !closing && !empty;
+			else if (tag == rph_tag) {
+				if (closing)
+					--in_rph;
+				else if (!empty)
+					++in_rph;
+			}
+		} else if (in_si && in_t && (in_rph == 0)) {
+			if (c == '&') {
+				entity.clear();
+				for (c = next_char(); (c != -1) && (c != ';') && (c != '<'); c = next_char())
+					entity += char(c);
+				if (c != ';')
+					throw Exception{ "unable to found the ';' char after the “&" + entity + "” entity (" +
+						               file_name + " corrupted?)" };
+				append_entity(rvo.pool, entity);
+			} else
+				rvo.pool += char(c);
 		}
-		replace_all(str, "&lt;", '<');
-		replace_all(str, "&gt;", '>');
-		replace_all(str, "&quot;", '"');
-		replace_all(str, "&apos;", '\'');
-		rvo.emplace_back(str);
-		pos = pos_si_1 + end_si_tag.size();
 	}
+	if (in_si)
+		throw Exception{ "unable to found the “</" + si_tag + ">” tag after the “<" + si_tag +
+			               ">” tag (" + file_name + " corrupted?)" };
+}
+SharedStrings
+get_shared_strings(zip_t* archive_ptr,
+                   str_t const& file_name,
+                   str_t const& nmspace,
+                   Monitor* monitor)
+{
+	if (is_bin(file_name))
+		return get_shared_strings_bin(archive_ptr, file_name, monitor);
+
+	SharedStrings rvo;
+	ZipReader reader{ archive_ptr, file_name, monitor };
+	if (monitor && (monitor->limits().shared_strings_bytes || monitor->limits().memory)) {
+		// The size of the pool is checked at each string.
+		size_t count{};
+		parse_shared_strings(
+		  [&]() {
+			  if (rvo.size() != count) {
+				  count = rvo.size();
+				  monitor->strings(rvo.pool.size(), rvo.pool.size() + count * sizeof(size_t));
+			  }
+			  return reader.next_char();
+		  },
+		  file_name,
+		  nmspace,
+		  rvo);
+	} else
+		parse_shared_strings([&]() { return reader.next_char(); }, file_name, nmspace, rvo);
+	if (monitor)
+		monitor->allocate(rvo.pool.size() + rvo.offsets.size() * sizeof(size_t));
+	return rvo;
+}
+SharedStrings
+get_shared_strings(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace)
+{
+	return get_shared_strings(archive_ptr, file_name, nmspace, nullptr);
+}
+SharedStrings
+get_shared_strings(zip_t* archive_ptr,
+                   str_t const& file_name,
+                   str_t const& nmspace,
+                   unsigned threads,
+                   Monitor* monitor)
+{
+	if ((threads < 2) || is_bin(file_name))
+		return get_shared_strings(archive_ptr, file_name, nmspace, monitor);
+
+	auto const contents{ ZipReader{ archive_ptr, file_name, monitor }.read_all() };
+	// The pieces begin at a <si> tag (the first one at the beginning of the part): a text cannot
+	// contain a '<' char, so the tags found are real tags.
+	auto const si_tag{ '<' + ((nmspace == "") ? nmspace : (nmspace + ':')) + "si" };
+	std::vector<size_t> bounds{ 0 };
+	for (size_t k{ 1 }; k < threads; ++k) {
+		auto pos{ contents.find(si_tag, std::max(bounds.back() + 1, k * contents.size() / threads)) };
+		while ((pos != str_t::npos) && (pos + si_tag.size() < contents.size()) &&
+		       !std::strchr(" \t\n\r/>", contents[pos + si_tag.size()]))
+			pos = contents.find(si_tag, pos + 1);
+		if (pos == str_t::npos)
+			break;
+		bounds.push_back(pos);
+	}
+	bounds.push_back(contents.size());
 
+	std::vector<SharedStrings> pieces(bounds.size() - 1);
+	std::vector<std::future<void>> tasks;
+	for (size_t k{}; k < pieces.size(); ++k)
+		tasks.push_back(std::async(std::launch::async, [&, k]() {
+			auto pos{ bounds[k] };
+			auto const end{ bounds[k + 1] };
+			parse_shared_strings(
+			  [&]() {
+				  // The cancellation and the deadline are checked every 64 KiB.
+				  if (monitor && ((pos & 0xffff) == 0))
+					  monitor->check();
+				  return (pos < end) ? static_cast<unsigned char>(contents[pos++]) : -1;
+			  },
+			  file_name,
+			  nmspace,
+			  pieces[k]);
+		}));
+	for (auto& task : tasks)
+		task.get();
+
+	SharedStrings rvo;
+	size_t pool{}, count{};
+	for (auto const& piece : pieces) {
+		pool += piece.pool.size();
+		count += piece.size();
+	}
+	if (monitor)
+		monitor->strings(pool, pool + count * sizeof(size_t));
+	rvo.pool.reserve(pool);
+	rvo.offsets.reserve(count + 1);
+	for (auto const& piece : pieces) {
+		auto const base{ rvo.pool.size() };
+		rvo.pool += piece.pool;
+		for (auto it{ cbegin(piece.offsets) + 1 }; it != cend(piece.offsets); ++it)
+			rvo.offsets.push_back(base + *it);
+	}
+	if (monitor)
+		monitor->allocate(rvo.pool.size() + rvo.offsets.size() * sizeof(size_t));
 	return rvo;
 }
 
 // This function returns the tuple of the xml namespace, the map of (sheet ids, sheet names) and
 // active sheet name.
 std::tuple<str_t, std::map<str_t, str_t>, str_t>
-get_ns_ids_and_active(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name)
+get_ns_ids_and_active(zip_t* archive_ptr,
+                      str_t const& wb_base,
+                      str_t const& wb_name,
+                      bool& date1904,
+                      Monitor* monitor)
 {
+	if (is_bin(wb_name))
+		return get_ids_and_active_bin(archive_ptr, wb_base, wb_name, date1904, monitor);
+
 	// We presume that the file is not so big ; so we can get it in memory.
-	auto const contents{ get_contents(archive_ptr, wb_base + '/' + wb_name) };
+	auto const contents{ get_contents(archive_ptr, wb_base + '/' + wb_name, monitor) };
 
 	// Guess the namespace: if we find a tag with <NAMESPACE:workbook ... xmlns:NAMESPACE=... then
 	// NAMESPACE is the namespace.
@@ -188,6 +473,13 @@ get_ns_ids_and_active(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_
 		return end ? 0 : std::stoi(str);
 	}() };
 
+	// <workbookPr date1904="1"/>
+	{
+		auto const [str, pos, end, err]{ get_attribute(
+			contents, 0, nmspace, "workbookPr ", "date1904") };
+		date1904 = !end && !err && ((str == "1") || (str == "true"));
+	}
+
 	std::map<str_t, str_t> ids;
 	str_t::size_type pos{};
 	str_t active_name;
@@ -211,8 +503,14 @@ get_ns_ids_and_active(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_
 		pos = pos_rid;
 	}
 }
+std::tuple<str_t, std::map<str_t, str_t>, str_t>
+get_ns_ids_and_active(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name)
+{
+	bool date1904;
+	return get_ns_ids_and_active(archive_ptr, wb_base, wb_name, date1904, nullptr);
+}
 // For debug.
-std::vector<str_t>
+SharedStrings
 get_shared_strings(char const* const xlsx_file_name)
 {
 	int zip_error;
@@ -225,10 +523,10 @@ get_shared_strings(char const* const xlsx_file_name)
 }
 
 std::pair<str_t, str_t>
-get_wb_base_and_name(zip_t* archive_ptr)
+get_wb_base_and_name(zip_t* archive_ptr, Monitor* monitor)
 {
 	// We presume that the file is not so big ; so we can get it in memory.
-	auto const contents{ get_contents(archive_ptr, "_rels/.rels") };
+	auto const contents{ get_contents(archive_ptr, "_rels/.rels", monitor) };
 	// We are looking for <Relationship
 	// Type="http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument"
 	// Target="xl/workbook.xml"/>
@@ -250,11 +548,21 @@ get_wb_base_and_name(zip_t* archive_ptr)
 		pos = pos_target;
 	}
 }
+std::pair<str_t, str_t>
+get_wb_base_and_name(zip_t* archive_ptr)
+{
+	return get_wb_base_and_name(archive_ptr, nullptr);
+}
 std::tuple<str_t, std::map<str_t, str_t>, str_t>
-get_ws_and_shared(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name)
+get_ws_and_shared(zip_t* archive_ptr,
+                  str_t const& wb_base,
+                  str_t const& wb_name,
+                  str_t& styles,
+                  Monitor* monitor)
 {
 	// We presume that the file is not so big ; so we can get it in memory.
-	auto const contents{ get_contents(archive_ptr, wb_base + "/_rels/" + wb_name + ".rels") };
+	auto const contents{ get_contents(
+	  archive_ptr, wb_base + "/_rels/" + wb_name + ".rels", monitor) };
 	// We are looking for
 	// <Relationship
 	//   Id="rId1"
@@ -265,7 +573,13 @@ get_ws_and_shared(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name
 	//   Id="rId2"
 	//   Type="http://schemas.openxmlformats.org/officeDocument/2006/relationships/sharedStrings"
 	//   Target="sharedStrings.xml"/>
+	// or
+	// <Relationship
+	//   Id="rId3"
+	//   Type="http://schemas.openxmlformats.org/officeDocument/2006/relationships/styles"
+	//   Target="styles.xml"/>
 
+	styles.clear();
 	str_t base;
 	std::map<str_t, str_t> names;
 	str_t shared;
@@ -300,10 +614,628 @@ get_ws_and_shared(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name
 					shared = target;
 			} else
 				shared = wb_base + '/' + target;
+		} else if (type.find("relationships/styles") != str_t::npos) {
+			if (target.find('/') == str_t::npos)
+				styles = wb_base + '/' + target;
+			else
+				styles = (target[0] == '/') ? str_t{ cbegin(target) + 1, cend(target) } : target;
 		}
 		pos = pos_target;
 	}
 }
+std::tuple<str_t, std::map<str_t, str_t>, str_t>
+get_ws_and_shared(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name)
+{
+	str_t styles;
+	return get_ws_and_shared(archive_ptr, wb_base, wb_name, styles, nullptr);
+}
+
+// Styles. The “s” attribute of a cell is an index in the <cellXfs> list of the styles part; each
+// <xf> of this list refers to a number format, built-in (the id is lower than 164) or defined in
+// the <numFmts> list. We only keep the kind of the number format of each style.
+style_kind_t
+get_format_kind(size_t id, str_t const& code)
+{
+	// Built-in formats.
+	if ((id == 9) || (id == 10))
+		return style_kind_t::percent;
+	if (((14 <= id) && (id <= 17)) || ((27 <= id) && (id <= 36)) || ((50 <= id) && (id <= 58)))
+		return style_kind_t::date;
+	if (id == 46)
+		return style_kind_t::elapsed;
+	if (((18 <= id) && (id <= 21)) || (id == 45) || (id == 47))
+		return style_kind_t::time;
+	if (id == 22)
+		return style_kind_t::datetime;
+	// Custom formats: only the first section is used; the quoted strings, the escaped chars and the
+	// colors or conditions between brackets are skipped (but [h], [mm], [ss] are elapsed times).
+	bool date{}, time{}, elapsed{}, month{}, percent{};
+	for (size_t k{}; k < code.size(); ++k) {
+		auto const c{ char(std::tolower(static_cast<unsigned char>(code[k]))) };
+		if (c == ';')
+			break;
+		else if (c == '"') {
+			k = code.find('"', k + 1);
+			if (k == str_t::npos)
+				break;
+		} else if ((c == '\\') || (c == '_') || (c == '*'))
+			++k;
+		else if (c == '[') {
+			auto const end{ code.find(']', k) };
+			if (end == str_t::npos)
+				break;
+			auto const inner{ code.substr(k + 1, end - k - 1) };
+			if (!inner.empty() && (inner.find_first_not_of("hHmMsS") == str_t::npos))
+				time = elapsed = true;
+			k = end;
+		} else if ((c == 'y') || (c == 'd'))
+			date = true;
+		else if ((c == 'h') || (c == 's'))
+			time = true;
+		else if (c == 'm')
+			month = true;
+		else if (c == '%')
+			percent = true;
+		else if ((c == 'g') && (code.compare(k, 7, "General") == 0))
+			k += 6;
+		else if ((c == 'a') && ((code.compare(k, 5, "AM/PM") == 0) || (code.compare(k, 3, "A/P") == 0)))
+			time = true;
+	}
+	// “m” is a month without hours or seconds, a minute otherwise.
+	date = date || (month && !time);
+	if (date && time)
+		return style_kind_t::datetime;
+	if (date)
+		return style_kind_t::date;
+	if (elapsed)
+		return style_kind_t::elapsed;
+	if (time)
+		return style_kind_t::time;
+	return percent ? style_kind_t::percent : style_kind_t::number;
+}
+std::vector<style_kind_t>
+get_styles(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace, Monitor* monitor)
+{
+	if (is_bin(file_name))
+		return get_styles_bin(archive_ptr, file_name, monitor);
+
+	// We presume that the file is not so big ; so we can get it in memory.
+	auto const contents{ get_contents(archive_ptr, file_name, monitor) };
+	auto const prefix{ (nmspace == "") ? nmspace : (nmspace + ':') };
+	// The value of the attribute “attr” in the tag beginning at “pos”.
+	auto const attribute{ [&](str_t::size_type pos, char const* const attr) -> str_t {
+		auto const end{ contents.find('>', pos) };
+		auto const pos1{ contents.find(' ' + str_t(attr) + '=', pos) };
+		if ((pos1 == str_t::npos) || (pos1 > end))
+			return "";
+		auto const quote{ contents[pos1 + strlen(attr) + 2] };
+		auto const pos2{ contents.find(quote, pos1 + strlen(attr) + 3) };
+		if (pos2 == str_t::npos)
+			throw Exception{ "unable to found the closing quote of the “" + str_t(attr) +
+				               "” attribute (" + file_name + " corrupted?)" };
+		return contents.substr(pos1 + strlen(attr) + 3, pos2 - pos1 - strlen(attr) - 3);
+	} };
+
+	// <numFmt numFmtId="164" formatCode="yyyy\-mm\-dd"/>
+	std::map<size_t, str_t> codes;
+	auto const numfmt_tag{ '<' + prefix + "numFmt " };
+	for (auto pos{ contents.find(numfmt_tag) }; pos != str_t::npos;
+	     pos = contents.find(numfmt_tag, pos + 1)) {
+		auto const id{ attribute(pos, "numFmtId") };
+		if (!id.empty())
+			codes[std::stoul(id)] = decode_entities(attribute(pos, "formatCode"));
+	}
+
+	// <cellXfs count="2"> <xf numFmtId="0" .../> <xf numFmtId="164" ...> ... </xf> </cellXfs>
+	std::vector<style_kind_t> rvo;
+	auto const beg{ contents.find('<' + prefix + "cellXfs") };
+	if (beg == str_t::npos)
+		return rvo;
+	auto const end{ contents.find("</" + prefix + "cellXfs>", beg) };
+	auto const xf_tag{ '<' + prefix + "xf" };
+	for (auto pos{ contents.find(xf_tag, beg) }; pos < end; pos = contents.find(xf_tag, pos + 1)) {
+		auto const next{ contents[pos + xf_tag.size()] };
+		if ((next != ' ') && (next != '>') && (next != '/'))
+			continue;
+		auto const id_str{ attribute(pos, "numFmtId") };
+		auto const id{ id_str.empty() ? size_t{} : size_t(std::stoul(id_str)) };
+		auto const it{ codes.find(id) };
+		rvo.push_back(get_format_kind(id, (it == cend(codes)) ? "" : it->second));
+	}
+	return rvo;
+}
+std::vector<style_kind_t>
+get_styles(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace)
+{
+	return get_styles(archive_ptr, file_name, nmspace, nullptr);
+}
+str_t
+serial_to_iso(double serial, style_kind_t kind, bool date1904)
+{
+	// Round to the second.
+	auto const total{ int64_t(std::floor(serial * 86400. + 0.5)) };
+	auto days{ int64_t(std::floor(double(total) / 86400.)) };
+	auto const seconds{ total - days * 86400 };
+	char buffer[160];
+	if ((kind == style_kind_t::time) || (kind == style_kind_t::elapsed)) {
+		// Only an elapsed time may be greater than 24 hours.
+		auto const hours{ ((kind == style_kind_t::elapsed) ? days * 24 : 0) + seconds / 3600 };
+		std::snprintf(buffer,
+		              sizeof(buffer),
+		              "%02lld:%02lld:%02lld",
+		              static_cast<long long>(hours),
+		              static_cast<long long>((seconds / 60) % 60),
+		              static_cast<long long>(seconds % 60));
+		return buffer;
+	}
+	// Days since 1970-01-01: the serial 0 is 1899-12-30 (1904-01-01 for the 1904 date system); with
+	// the 1900 date system, the serials lower than 61 are shifted by the fictitious 1900-02-29.
+	if (date1904)
+		days -= 24107;
+	else
+		days -= (days < 61) ? 25568 : 25569;
+	// Civil date from the days (Howard Hinnant's algorithm).
+	days += 719468;
+	auto const era{ (days >= 0 ? days : days - 146096) / 146097 };
+	auto const doe{ days - era * 146097 };
+	auto const yoe{ (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365 };
+	auto const doy{ doe - (365 * yoe + yoe / 4 - yoe / 100) };
+	auto const mp{ (5 * doy + 2) / 153 };
+	auto const d{ doy - (153 * mp + 2) / 5 + 1 };
+	auto const m{ mp < 10 ? mp + 3 : mp - 9 };
+	auto const y{ yoe + era * 400 + (m <= 2) };
+	if (kind == style_kind_t::date)
+		std::snprintf(buffer,
+		              sizeof(buffer),
+		              "%04lld-%02lld-%02lld",
+		              static_cast<long long>(y),
+		              static_cast<long long>(m),
+		              static_cast<long long>(d));
+	else
+		std::snprintf(buffer,
+		              sizeof(buffer),
+		              "%04lld-%02lld-%02lldT%02lld:%02lld:%02lld",
+		              static_cast<long long>(y),
+		              static_cast<long long>(m),
+		              static_cast<long long>(d),
+		              static_cast<long long>(seconds / 3600),
+		              static_cast<long long>((seconds / 60) % 60),
+		              static_cast<long long>(seconds % 60));
+	return buffer;
+}
+void
+apply_date_style(cell_view_t& v, bool date1904, str_t& buffer)
+{
+	if ((v.style != style_kind_t::date) && (v.style != style_kind_t::time) &&
+	    (v.style != style_kind_t::datetime) && (v.style != style_kind_t::elapsed))
+		return;
+	double serial;
+	switch (v.kind) {
+		case cell_view_t::kind_t::string:
+		case cell_view_t::kind_t::shared:
+			return;
+		case cell_view_t::kind_t::integer:
+			serial = double(v.integer);
+			break;
+		case cell_view_t::kind_t::real:
+			serial = v.real;
+			break;
+		case cell_view_t::kind_t::text: {
+			auto const [ptr, ec]{ std::from_chars(v.str.data(), v.str.data() + v.str.size(), serial) };
+			if ((ec != std::errc{}) || (ptr != v.str.data() + v.str.size()))
+				return;
+			break;
+		}
+	}
+	buffer = serial_to_iso(serial, v.style, date1904);
+	v.kind = cell_view_t::kind_t::string;
+	v.str = buffer;
+}
+
+// Binary (xlsb) workbooks. The parts are sequences of BIFF12 records: a record type (1 or 2 bytes),
+// a record size (1 to 4 bytes), both with 7 bits per byte and the high bit set if another byte
+// follows, and the record data.
+bool
+is_bin(str_t const& file_name)
+{
+	return (file_name.size() >= 4) && (file_name.compare(file_name.size() - 4, 4, ".bin") == 0);
+}
+
+// Class for RAII: the reader of the records of a binary part.
+class Biff12
+{
+public:
+	// The monitor, if any, is given each chunk read.
+	Biff12(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor)
+	  : file_name_(file_name)
+	  , file_ptr_(zip_fopen(archive_ptr, file_name.c_str(), 0))
+	  , monitor_(monitor)
+	{
+		if (!file_ptr_)
+			throw Exception{ "unable to open the “" + file_name + "” file" };
+		if (monitor_)
+			try {
+				monitor_->open(archive_ptr, file_name);
+			} catch (...) {
+				zip_fclose(file_ptr_);
+				throw;
+			}
+	}
+	Biff12(zip_t* archive_ptr, str_t const& file_name)
+	  : Biff12(archive_ptr, file_name, nullptr)
+	{}
+	~Biff12() { zip_fclose(file_ptr_); }
+	// Read the next record. Returns false at the end of the part.
+	bool next(uint32_t& type, str_t& data)
+	{
+		auto c{ next_byte() };
+		if (c == -1)
+			return false;
+		type = uint32_t(c & 0x7f);
+		if (c & 0x80) {
+			c = next_byte();
+			if (c == -1)
+				corrupted();
+			type |= uint32_t(c & 0x7f) << 7;
+		}
+		uint32_t size{};
+		for (int k{}; k < 4; ++k) {
+			c = next_byte();
+			if (c == -1)
+				corrupted();
+			size |= uint32_t(c & 0x7f) << (7 * k);
+			if (!(c & 0x80))
+				break;
+		}
+		data.resize(size);
+		for (size_t pos{}; pos < size;) {
+			if (i_ == n_)
+				fill();
+			auto const count{ std::min(size - pos, n_ - i_) };
+			std::memcpy(&data[pos], buffer_ + i_, count);
+			pos += count;
+			i_ += count;
+		}
+		return true;
+	}
+	[[noreturn]] void corrupted() const
+	{
+		throw Exception{ "truncated record (" + file_name_ + " corrupted?)" };
+	}
+
+private:
+	// Read the next chunk. Returns false at the end of the part; a read error is not its end.
+	bool read()
+	{
+		auto const n{ zip_fread(file_ptr_, buffer_, sizeof(buffer_)) };
+		if (n < 0)
+			throw Exception{ "unable to read the “" + file_name_ + "” file (file corrupted?)" };
+		n_ = size_t(n);
+		i_ = 0;
+		if (monitor_ && (n_ != 0))
+			monitor_->chunk(n_);
+		return n_ != 0;
+	}
+	void fill()
+	{
+		if (!read())
+			corrupted();
+	}
+	int next_byte()
+	{
+		if ((i_ == n_) && !read())
+			return -1;
+		return static_cast<unsigned char>(buffer_[i_++]);
+	}
+	str_t const file_name_;
+	zip_file_t* const file_ptr_;
+	Monitor* const monitor_;
+	char buffer_[4096];
+	size_t n_{}, i_{};
+};
+
+// Little endian integers within the data of a record.
+uint32_t
+get_u32(Biff12 const& biff12, str_t const& data, size_t pos)
+{
+	if (pos + 4 > data.size())
+		biff12.corrupted();
+	auto const p{ reinterpret_cast<unsigned char const*>(data.data()) + pos };
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+uint16_t
+get_u16(Biff12 const& biff12, str_t const& data, size_t pos)
+{
+	if (pos + 2 > data.size())
+		biff12.corrupted();
+	auto const p{ reinterpret_cast<unsigned char const*>(data.data()) + pos };
+	return uint16_t(p[0] | (p[1] << 8));
+}
+double
+get_xnum(Biff12 const& biff12, str_t const& data, size_t pos)
+{
+	auto const bits{ uint64_t(get_u32(biff12, data, pos)) |
+		               (uint64_t(get_u32(biff12, data, pos + 4)) << 32) };
+	double rvo;
+	std::memcpy(&rvo, &bits, sizeof(rvo));
+	return rvo;
+}
+// Get a XLWideString (a count of UTF-16 characters followed by the characters) as an UTF-8 string
+// and move “pos” after it.
+str_t
+get_wide_string(Biff12 const& biff12, str_t const& data, size_t& pos)
+{
+	auto const count{ get_u32(biff12, data, pos) };
+	pos += 4;
+	if ((count > (data.size() - pos) / 2))
+		biff12.corrupted();
+	auto const p{ reinterpret_cast<unsigned char const*>(data.data()) + pos };
+	pos += 2 * size_t(count);
+	str_t rvo;
+	rvo.reserve(count);
+	for (size_t k{}; k < count; ++k) {
+		uint32_t u{ uint32_t(p[2 * k]) | (uint32_t(p[2 * k + 1]) << 8) };
+		// Surrogate pair.
+		if ((0xd800 <= u) && (u < 0xdc00) && (k + 1 < count)) {
+			uint32_t const low{ uint32_t(p[2 * k + 2]) | (uint32_t(p[2 * k + 3]) << 8) };
+			if ((0xdc00 <= low) && (low < 0xe000)) {
+				u = 0x10000 + ((u - 0xd800) << 10) + (low - 0xdc00);
+				++k;
+			}
+		}
+		append_utf8(rvo, u);
+	}
+	return rvo;
+}
+// RkNumber: the bit 0 is set if the value is multiplied by 100, the bit 1 is set if the 30 high
+// bits are a signed integer, otherwise they are the 30 high bits of a double.
+cell_view_t
+get_rk(uint32_t rk)
+{
+	cell_view_t rvo{};
+	if (rk & 0x2) {
+		auto const i{ int32_t(rk) >> 2 };
+		if (!(rk & 0x1)) {
+			rvo.kind = cell_view_t::kind_t::integer;
+			rvo.integer = i;
+			return rvo;
+		}
+		rvo.real = i;
+	} else {
+		auto const bits{ uint64_t(rk & 0xfffffffc) << 32 };
+		std::memcpy(&rvo.real, &bits, sizeof(rvo.real));
+	}
+	rvo.kind = cell_view_t::kind_t::real;
+	if (rk & 0x1)
+		rvo.real /= 100;
+	return rvo;
+}
+
+std::tuple<str_t, std::map<str_t, str_t>, str_t>
+get_ids_and_active_bin(zip_t* archive_ptr,
+                       str_t const& wb_base,
+                       str_t const& wb_name,
+                       bool& date1904,
+                       Monitor* monitor)
+{
+	// BrtBookView: ... itabCur (the index of the active sheet) at offset 24.
+	// BrtBundleSh: hsState, iTabID, strRelID, strName.
+	// BrtWbProp: flags (4 bytes), the bit 0 is f1904.
+	uint32_t constexpr brt_book_view{ 158 };
+	uint32_t constexpr brt_bundle_sh{ 156 };
+	uint32_t constexpr brt_wb_prop{ 153 };
+
+	Biff12 biff12{ archive_ptr, wb_base + '/' + wb_name, monitor };
+	uint32_t type;
+	str_t data;
+	std::map<str_t, str_t> ids;
+	uint32_t active_tab{};
+	std::vector<str_t> sheets;
+	date1904 = false;
+	while (biff12.next(type, data)) {
+		if (type == brt_wb_prop)
+			date1904 = get_u32(biff12, data, 0) & 0x1;
+		else if (type == brt_book_view)
+			active_tab = get_u32(biff12, data, 24);
+		else if (type == brt_bundle_sh) {
+			size_t pos{ 8 };
+			auto const rid{ get_wide_string(biff12, data, pos) };
+			auto const name{ get_wide_string(biff12, data, pos) };
+			ids[name] = rid;
+			sheets.push_back(name);
+		}
+	}
+	if (ids.empty())
+		throw Exception{ "unable to found the  sheet names (" + wb_base + '/' + wb_name +
+			               " corrupted?)" };
+	return { "", ids, (active_tab < sheets.size()) ? sheets[active_tab] : "" };
+}
+SharedStrings
+get_shared_strings_bin(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor)
+{
+	// BrtSSTItem: a RichStr, that is a flag byte followed by the string (and the formatting runs).
+	uint32_t constexpr brt_sst_item{ 19 };
+
+	Biff12 biff12{ archive_ptr, file_name, monitor };
+	uint32_t type;
+	str_t data;
+	SharedStrings rvo;
+	while (biff12.next(type, data))
+		if (type == brt_sst_item) {
+			size_t pos{ 1 };
+			rvo.pool += get_wide_string(biff12, data, pos);
+			rvo.push();
+			if (monitor)
+				monitor->strings(rvo.pool.size(), rvo.pool.size() + rvo.size() * sizeof(size_t));
+		}
+	if (monitor)
+		monitor->allocate(rvo.pool.size() + rvo.offsets.size() * sizeof(size_t));
+	return rvo;
+}
+std::vector<style_kind_t>
+get_styles_bin(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor)
+{
+	// BrtFmt: ifmt (2 bytes) and stFmtCode. BrtXF: ixfeParent (2 bytes) and iFmt (2 bytes), within
+	// BrtBeginCellXFs and BrtEndCellXFs.
+	uint32_t constexpr brt_fmt{ 44 };
+	uint32_t constexpr brt_xf{ 47 };
+	uint32_t constexpr brt_begin_cell_xfs{ 617 };
+	uint32_t constexpr brt_end_cell_xfs{ 618 };
+
+	Biff12 biff12{ archive_ptr, file_name, monitor };
+	uint32_t type;
+	str_t data;
+	std::map<size_t, str_t> codes;
+	std::vector<size_t> ids;
+	bool in_cell_xfs{};
+	while (biff12.next(type, data)) {
+		if (type == brt_fmt) {
+			size_t pos{ 2 };
+			codes[get_u16(biff12, data, 0)] = get_wide_string(biff12, data, pos);
+		} else if (type == brt_begin_cell_xfs)
+			in_cell_xfs = true;
+		else if (type == brt_end_cell_xfs)
+			in_cell_xfs = false;
+		else if ((type == brt_xf) && in_cell_xfs)
+			ids.push_back(get_u16(biff12, data, 2));
+	}
+	std::vector<style_kind_t> rvo;
+	rvo.reserve(ids.size());
+	for (auto const id : ids) {
+		auto const it{ codes.find(id) };
+		rvo.push_back(get_format_kind(id, (it == cend(codes)) ? "" : it->second));
+	}
+	return rvo;
+}
+void
+push_cell(table_t& rvo, row_t& row, size_t i, size_t j, cell_t&& v)
+{
+	// rvo.size() == 3 and i == 2 : error
+	// rvo.size() == 2 and i == 2 : do nothing
+	// rvo.size() == 1 and i == 2 : push the current row and clear it
+	// rvo.size() == 0 and i == 2 : push the current row, clear it and add 1
+	// empty row
+	if (rvo.size() > i)
+		throw Exception{ "rows not sorted (workbook corrupted?)" };
+	else if (rvo.size() < i) {
+		rvo.emplace_back(row);
+		row.clear();
+		auto const count = i - rvo.size();
+		for (size_t ii{}; ii < count; ++ii)
+			rvo.emplace_back(row);
+	}
+	// row.size() == 2 and j == 1 : error
+	// row.size() == 1 and j == 1 : push the element on the current row
+	// row.size() == 0 and j == 1 : add an empty cell and push the element
+	if (row.size() > j)
+		throw Exception{ "columns not sorted (workbook corrupted?)" };
+	else {
+		auto const count = j - row.size();
+		for (size_t jj{}; jj < count; ++jj)
+			row.emplace_back(cell_t{});
+		row.emplace_back(std::move(v));
+	}
+}
+void
+parse_sheet_bin(zip_t* archive_ptr,
+                Sheet const& sheet,
+                Options const& options,
+                cell_callback_t const& callback,
+                Monitor* monitor)
+{
+	// The cell records begin with the column (4 bytes) and the style (4 bytes) and are preceded by
+	// a BrtRowHdr record beginning with the row (4 bytes). The “short” cell records have only the
+	// style: the column is the column of the previous cell plus one. Blank and error cells are
+	// discarded.
+	enum : uint32_t
+	{
+		brt_row_hdr = 0,
+		brt_cell_blank = 1,
+		brt_cell_rk = 2,
+		brt_cell_bool = 4,
+		brt_cell_real = 5,
+		brt_cell_st = 6,
+		brt_cell_isst = 7,
+		brt_fmla_string = 8,
+		brt_fmla_num = 9,
+		brt_fmla_bool = 10,
+		brt_short_blank = 12,
+		brt_short_rk = 13,
+		brt_short_error = 14,
+		brt_short_bool = 15,
+		brt_short_real = 16,
+		brt_short_st = 17,
+		brt_short_isst = 18,
+	};
+
+	auto const& shared_strings{ *sheet.shared_strings };
+	auto const& styles{ *sheet.styles };
+	Biff12 biff12{ archive_ptr, sheet.file_name, monitor };
+	uint32_t type;
+	str_t data, str, iso;
+	size_t i{}, j{};
+	while (biff12.next(type, data)) {
+		if (type == brt_row_hdr) {
+			i = get_u32(biff12, data, 0);
+			continue;
+		}
+		if ((type < brt_cell_blank) || (type > brt_short_isst))
+			continue;
+		size_t pos;
+		if (type < brt_short_blank) {
+			j = get_u32(biff12, data, 0);
+			pos = 8;
+		} else {
+			++j;
+			pos = 4;
+		}
+		cell_view_t v{};
+		v.kind = cell_view_t::kind_t::real;
+		auto const style{ get_u32(biff12, data, pos - 4) & 0xffffff };
+		switch (type) {
+			case brt_cell_rk:
+			case brt_short_rk:
+				v = get_rk(get_u32(biff12, data, pos));
+				break;
+			case brt_cell_bool:
+			case brt_fmla_bool:
+			case brt_short_bool:
+				if (pos >= data.size())
+					biff12.corrupted();
+				v.kind = cell_view_t::kind_t::integer;
+				v.integer = (data[pos] != 0);
+				break;
+			case brt_cell_real:
+			case brt_fmla_num:
+			case brt_short_real:
+				v.real = get_xnum(biff12, data, pos);
+				break;
+			case brt_cell_st:
+			case brt_fmla_string:
+			case brt_short_st:
+				str = get_wide_string(biff12, data, pos);
+				v.kind = cell_view_t::kind_t::string;
+				v.str = str;
+				break;
+			case brt_cell_isst:
+			case brt_short_isst: {
+				auto const isst{ get_u32(biff12, data, pos) };
+				if (isst >= shared_strings.size())
+					throw Exception{ "invalid index for the a shared string (workbook corrupted?)" };
+				v.kind = cell_view_t::kind_t::string;
+				v.str = shared_strings[isst];
+				break;
+			}
+			default:
+				continue;
+		}
+		if (style < styles.size())
+			v.style = styles[style];
+		if (options.iso_dates)
+			apply_date_style(v, sheet.date1904, iso);
+		callback(i, j, v);
+	}
+}
 
 // Class for RAII.
 struct Zip
@@ -325,22 +1257,20 @@ struct Zip
 	zip_t* archive_ptr_;
 };
 
-// Read a sheet and returns a table (vectors of vectors) of variants.
-std::pair<std::vector<std::vector<cell_t>>, str_t>
-get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_name)
+Workbook
+get_workbook(zip_t* archive_ptr, Monitor* monitor)
 {
-
-	auto const zip{ Zip{ xlsx_file_name } };
-
 	// The archive tree is
 	//          _rels
 	//          xl
 	//          [Content_Types].xml
-	// We do not read [Content_Types].xml, assuming that the file is a xlsx file.
+	// We do not read [Content_Types].xml, assuming that the file is a xlsx (or xlsb) file: the parts
+	// of a xlsb file are “.bin” parts and are read by the “_bin” functions.
 	// We read the “_rels/.rels” file to get the workbook base and name (the base is
 	// usually “xl” and the name “workbook.xml”).
 
-	auto const [wb_base, wb_name]{ get_wb_base_and_name(zip.archive_ptr_) };
+	Workbook rvo;
+	std::tie(rvo.wb_base, rvo.wb_name) = get_wb_base_and_name(archive_ptr, monitor);
 
 	// The xl directory is
 	//          _rels
@@ -351,93 +1281,386 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 	// worksheets (the base is usually “worksheets", the Ids “rId1”, “rId2”, ... and the names
 	// “sheet1.xml”, “sheet2.xml”, ...) and the shared file name. ws_names is a map with rid as key
 	// and effective file name as value.
-	auto const [ws_base, ws_names, shared]{ get_ws_and_shared(zip.archive_ptr_, wb_base, wb_name) };
+	// The styles part is found in the same file.
+	std::tie(rvo.ws_base, rvo.ws_names, rvo.shared) =
+	  get_ws_and_shared(archive_ptr, rvo.wb_base, rvo.wb_name, rvo.styles, monitor);
 
-	// We read the “workbook.xml” to get the namespace, the worksheets effective names and the active
-	// sheet. ids is a map with sheet name as key and rid as value.
-	auto const [nmspace, ids, active]{ get_ns_ids_and_active(zip.archive_ptr_, wb_base, wb_name) };
+	// We read the “workbook.xml” to get the namespace, the worksheets effective names, the active
+	// sheet and the date system. ids is a map with sheet name as key and rid as value.
+	std::tie(rvo.nmspace, rvo.ids, rvo.active) =
+	  get_ns_ids_and_active(archive_ptr, rvo.wb_base, rvo.wb_name, rvo.date1904, monitor);
+	return rvo;
+}
+Workbook
+get_workbook(zip_t* archive_ptr)
+{
+	return get_workbook(archive_ptr, nullptr);
+}
+std::pair<str_t, str_t>
+get_sheet_file_name(Workbook const& wb, char const* const sheet_name)
+{
+	auto const& wb_base{ wb.wb_base };
+	auto const& ws_base{ wb.ws_base };
+	auto const& ws_names{ wb.ws_names };
+	auto const& ids{ wb.ids };
+	auto const& active{ wb.active };
 
-	auto const [sheet_file_name, sheetname]{ [&]() {
-		// The user asks for the active sheet.
-		if (sheet_name[0] == '\0') {
-			if (active == "")
-				return std::pair{ wb_base + '/' + ws_base + '/' + cbegin(ws_names)->second,
-					                cbegin(ws_names)->second };
-			else {
-				auto const it_ids{ ids.find(active) };
-				if (it_ids == cend(ids))
-					throw Exception{ "unable to get the active sheet (file corrupted?)" };
-				auto const it_names{ ws_names.find(it_ids->second) };
-				if (it_names == cend(ws_names))
-					throw Exception{ "unable to get the requested sheet (file corrupted?)" };
-				return std::pair{ wb_base + '/' + ws_base + '/' + it_names->second, active };
-			}
+	// The user asks for the active sheet.
+	if (sheet_name[0] == '\0') {
+		if (active == "")
+			return std::pair{ wb_base + '/' + ws_base + '/' + cbegin(ws_names)->second,
+				                cbegin(ws_names)->second };
+		else {
+			auto const it_ids{ ids.find(active) };
+			if (it_ids == cend(ids))
+				throw Exception{ "unable to get the active sheet (file corrupted?)" };
+			auto const it_names{ ws_names.find(it_ids->second) };
+			if (it_names == cend(ws_names))
+				throw Exception{ "unable to get the requested sheet (file corrupted?)" };
+			return std::pair{ wb_base + '/' + ws_base + '/' + it_names->second, active };
 		}
-		// The user asks for a requested sheet.
-		auto const it_ids{ ids.find(sheet_name) };
-		if (it_ids == cend(ids))
-			throw Exception{ "the requested sheet “" + str_t{ sheet_name } + "” is not in the workbook" };
-		auto const it_names{ ws_names.find(it_ids->second) };
-		if (it_names == cend(ws_names))
-			throw Exception{ "unable to get the requested sheet (file corrupted?)" };
-		return std::pair{ wb_base + '/' + ws_base + '/' + it_names->second, str_t{ sheet_name } };
-	}() };
-
-	auto const shared_strings{ shared.empty()
-		                           ? std::vector<str_t>{}
-		                           : get_shared_strings(zip.archive_ptr_, shared, nmspace) };
-
-	std::vector<std::vector<cell_t>> rvo;
-
-	auto const file_ptr{ zip_fopen(zip.archive_ptr_, sheet_file_name.c_str(), 0) };
-	if (!file_ptr)
-		throw Exception{ "unable to open the “" + sheet_file_name + "” file" };
+	}
+	// The user asks for a requested sheet.
+	auto const it_ids{ ids.find(sheet_name) };
+	if (it_ids == cend(ids))
+		throw Exception{ "the requested sheet “" + str_t{ sheet_name } + "” is not in the workbook" };
+	auto const it_names{ ws_names.find(it_ids->second) };
+	if (it_names == cend(ws_names))
+		throw Exception{ "unable to get the requested sheet (file corrupted?)" };
+	return std::pair{ wb_base + '/' + ws_base + '/' + it_names->second, str_t{ sheet_name } };
+}
+WorkbookData
+get_workbook_data(zip_t* archive_ptr, Monitor* monitor, unsigned threads)
+{
+	auto wb{ get_workbook(archive_ptr, monitor) };
+	auto shared_strings{ std::make_shared<SharedStrings const>(
+	  wb.shared.empty() ? SharedStrings{}
+	                    : get_shared_strings(archive_ptr, wb.shared, wb.nmspace, threads, monitor)) };
+	auto styles{ std::make_shared<std::vector<style_kind_t> const>(
+	  wb.styles.empty() ? std::vector<style_kind_t>{}
+	                    : get_styles(archive_ptr, wb.styles, wb.nmspace, monitor)) };
+	return { std::move(wb), std::move(shared_strings), std::move(styles) };
+}
+WorkbookData
+get_workbook_data(zip_t* archive_ptr, Monitor* monitor)
+{
+	return get_workbook_data(archive_ptr, monitor, 0);
+}
+WorkbookData
+get_workbook_data(zip_t* archive_ptr)
+{
+	return get_workbook_data(archive_ptr, nullptr);
+}
+Sheet
+get_sheet(WorkbookData const& data, char const* const sheet_name)
+{
+	auto const [file_name, name]{ get_sheet_file_name(data.wb, sheet_name) };
+	return {
+		file_name, name, data.wb.nmspace, data.shared_strings, data.styles, data.wb.date1904
+	};
+}
+// Get the parts to read for the requested sheet (the active sheet if “sheet_name” is empty).
+Sheet
+get_sheet(zip_t* archive_ptr, char const* const sheet_name)
+{
+	return get_sheet(get_workbook_data(archive_ptr), sheet_name);
+}
+Sheet
+get_sheet(zip_t* archive_ptr,
+          str_t const& xlsx_file_name,
+          char const* const sheet_name,
+          Options const& options,
+          Monitor& monitor)
+{
+	auto const monitor_ptr{ monitor.active() ? &monitor : nullptr };
+	if (monitor_ptr)
+		monitor.check_archive(archive_ptr);
+	if (!options.cache)
+		return get_sheet(get_workbook_data(archive_ptr, monitor_ptr, options.threads), sheet_name);
+	return get_sheet(*Cache::instance().get(xlsx_file_name, archive_ptr, monitor_ptr), sheet_name);
+}
+Sheet
+get_sheet(zip_t* archive_ptr,
+          str_t const& xlsx_file_name,
+          char const* const sheet_name,
+          Options const& options)
+{
+	Monitor monitor{ options };
+	return get_sheet(archive_ptr, xlsx_file_name, sheet_name, options, monitor);
+}
+Monitor::Monitor(Options const& options)
+  : options_(options)
+  , active_(options.cancel || options.deadline || options.progress ||
+            options.limits.uncompressed_bytes || (options.limits.compression_ratio > 0) ||
+            options.limits.rows || options.limits.columns || options.limits.cells ||
+            options.limits.shared_strings_bytes || options.limits.memory)
+  , strings_limit_(options.limits.shared_strings_bytes ? options.limits.shared_strings_bytes
+                                                      : std::numeric_limits<uint64_t>::max())
+  , memory_limit_(options.limits.memory ? options.limits.memory
+                                        : std::numeric_limits<uint64_t>::max())
+{}
+void
+Monitor::check_part(str_t const& file_name, uint64_t size, uint64_t comp_size) const
+{
+	auto const& limits{ options_.limits };
+	if (limits.uncompressed_bytes && (size > limits.uncompressed_bytes))
+		throw UncompressedSizeExceeded{ "the “" + file_name +
+			                              "” part exceeds the uncompressed size limit" };
+	if ((limits.compression_ratio > 0) &&
+	    (double(size) > limits.compression_ratio * double(comp_size)))
+		throw CompressionRatioExceeded{ "the “" + file_name +
+			                              "” part exceeds the compression ratio limit" };
+}
+void
+Monitor::check_archive(zip_t* archive_ptr)
+{
+	auto const& limits{ options_.limits };
+	if (!limits.uncompressed_bytes && !(limits.compression_ratio > 0))
+		return;
+	auto const count{ zip_get_num_entries(archive_ptr, 0) };
+	for (zip_int64_t k{}; k < count; ++k) {
+		zip_stat_t st;
+		zip_stat_init(&st);
+		if ((zip_stat_index(archive_ptr, zip_uint64_t(k), 0, &st) == 0) &&
+		    (st.valid & ZIP_STAT_SIZE) && (st.valid & ZIP_STAT_COMP_SIZE))
+			check_part((st.valid & ZIP_STAT_NAME) ? st.name : "", st.size, st.comp_size);
+	}
+}
+void
+Monitor::open(zip_t* archive_ptr, str_t const& file_name)
+{
+	part_ = file_name;
+	part_bytes_ = 0;
+	part_comp_size_ = 0;
+	zip_stat_t st;
+	zip_stat_init(&st);
+	if ((zip_stat(archive_ptr, file_name.c_str(), 0, &st) == 0) && (st.valid & ZIP_STAT_SIZE) &&
+	    (st.valid & ZIP_STAT_COMP_SIZE)) {
+		part_comp_size_ = st.comp_size;
+		check_part(file_name, st.size, st.comp_size);
+	}
+}
+void
+Monitor::cell_limit_exceeded(size_t i, size_t j) const
+{
+	auto const& limits{ options_.limits };
+	if (limits.rows && (i >= limits.rows))
+		throw RowsLimitExceeded{ "rows limit exceeded" };
+	if (limits.columns && (j >= limits.columns))
+		throw ColumnsLimitExceeded{ "columns limit exceeded" };
+	throw CellsLimitExceeded{ "cells limit exceeded" };
+}
+void
+Monitor::strings_limit_exceeded(uint64_t pool) const
+{
+	if (pool > strings_limit_)
+		throw SharedStringsLimitExceeded{ "shared strings limit exceeded" };
+	throw MemoryLimitExceeded{ "memory limit exceeded" };
+}
+void
+Monitor::chunk(size_t bytes)
+{
+	bytes_ += bytes;
+	// The sizes of the archive directory may be wrong.
+	part_bytes_ += bytes;
+	if (part_comp_size_ != 0)
+		check_part(part_, part_bytes_, part_comp_size_);
+	else if (options_.limits.uncompressed_bytes)
+		check_part(part_, part_bytes_, part_bytes_);
+	check();
+	if (options_.progress)
+		options_.progress(bytes_, rows_);
+}
+void
+Monitor::check() const
+{
+	if (options_.cancel && options_.cancel->load(std::memory_order_relaxed))
+		throw Cancelled{ "read cancelled" };
+	if (options_.deadline && (std::chrono::steady_clock::now() > *options_.deadline))
+		throw DeadlineExceeded{ "read deadline exceeded" };
+}
 
-	char buffer[1024];
-	size_t n{};
-	size_t i{};
+Cache&
+Cache::instance()
+{
+	static Cache cache;
+	return cache;
+}
+void
+Cache::set_budget(size_t bytes)
+{
+	std::lock_guard<std::mutex> const lock{ mutex_ };
+	budget_ = bytes;
+	while ((bytes_ > budget_) && !lru_.empty())
+		erase(entries_.find(lru_.back()));
+}
+size_t
+Cache::size() const
+{
+	std::lock_guard<std::mutex> const lock{ mutex_ };
+	return entries_.size();
+}
+size_t
+Cache::bytes() const
+{
+	std::lock_guard<std::mutex> const lock{ mutex_ };
+	return bytes_;
+}
+void
+Cache::clear()
+{
+	std::lock_guard<std::mutex> const lock{ mutex_ };
+	entries_.clear();
+	lru_.clear();
+	bytes_ = 0;
+}
+void
+Cache::erase(std::map<Key, Entry>::iterator it)
+{
+	bytes_ -= it->second.bytes;
+	lru_.erase(it->second.lru);
+	entries_.erase(it);
+}
+// Approximate size of a decoded workbook.
+size_t
+get_bytes(WorkbookData const& data)
+{
+	auto const& wb{ data.wb };
+	auto rvo{ sizeof(WorkbookData) + data.shared_strings->pool.capacity() +
+		        data.shared_strings->offsets.capacity() * sizeof(size_t) +
+		        data.styles->capacity() * sizeof(style_kind_t) };
+	for (auto const& str : { wb.wb_base, wb.wb_name, wb.ws_base, wb.shared, wb.nmspace, wb.active })
+		rvo += str.size();
+	for (auto const& p : wb.ws_names)
+		rvo += p.first.size() + p.second.size() + 64;
+	for (auto const& p : wb.ids)
+		rvo += p.first.size() + p.second.size() + 64;
+	return rvo;
+}
+std::shared_ptr<WorkbookData const>
+Cache::get(str_t const& xlsx_file_name, zip_t* archive_ptr, Monitor* monitor)
+{
+	struct stat st;
+	if (stat(xlsx_file_name.c_str(), &st) != 0)
+		throw Exception{ "unable to get the status of the “" + xlsx_file_name + "” workbook" };
+	Key const key{ xlsx_file_name, st.st_dev, st.st_ino, st.st_mtime, st.st_size };
 
-	auto const next_char{ [&]() -> int {
-		if (i == n) {
-			n = zip_fread(file_ptr, buffer, sizeof(buffer));
-			if (n == 0)
-				return -1;
-			i = 0;
+	std::promise<std::shared_ptr<WorkbookData const>> promise;
+	std::shared_future<std::shared_ptr<WorkbookData const>> hit;
+	uint64_t id{};
+	{
+		std::lock_guard<std::mutex> const lock{ mutex_ };
+		auto const it{ entries_.find(key) };
+		if (it != cend(entries_)) {
+			lru_.splice(begin(lru_), lru_, it->second.lru);
+			hit = it->second.data;
+		} else {
+			// The other versions of the file are stale.
+			Key const first{ xlsx_file_name, 0, 0, std::numeric_limits<int64_t>::min(), 0 };
+			for (auto it_path{ entries_.lower_bound(first) };
+			     (it_path != cend(entries_)) && (std::get<0>(it_path->first) == xlsx_file_name);)
+				erase(it_path++);
+			id = ++id_;
+			lru_.push_front(key);
+			entries_.emplace(key, Entry{ promise.get_future().share(), id, 0, begin(lru_) });
 		}
-		return buffer[i++];
-	} };
-
-	std::vector<cell_t> row;
+	}
+	// Waiting for the thread decoding the workbook, if any.
+	if (hit.valid()) {
+		// By slices, the cancellation and the deadline of this read being checked between them.
+		if (monitor)
+			while (hit.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready)
+				monitor->check();
+		std::shared_ptr<WorkbookData const> rvo;
+		try {
+			rvo = hit.get();
+		} catch (Cancelled const&) {
+		} catch (DeadlineExceeded const&) {
+		} catch (LimitExceeded const&) {
+		}
+		// The read of the other thread was interrupted (or its limits exceeded): the workbook is
+		// decoded again, under the options of this read.
+		if (!rvo)
+			return get(xlsx_file_name, archive_ptr, monitor);
+		// The shared strings of the entry are checked against the limits of this read.
+		if (monitor) {
+			auto const& shared_strings{ *rvo->shared_strings };
+			auto const bytes{ shared_strings.pool.size() +
+				                shared_strings.offsets.size() * sizeof(size_t) };
+			monitor->strings(shared_strings.pool.size(), bytes);
+			monitor->allocate(bytes);
+		}
+		return rvo;
+	}
 
-	auto const push_value{ [&](str_t& ref, str_t& type, str_t& value) {
-		cell_t v;
-		// String inline.
-		if (type == "inlineStr") {
-			replace_all(value, "&lt;", '<');
-			replace_all(value, "&gt;", '>');
-			replace_all(value, "&quot;", '"');
-			replace_all(value, "&apos;", '\'');
-			v = value;
+	// Decoded without the lock.
+	try {
+		auto const rvo{ std::make_shared<WorkbookData const>(get_workbook_data(archive_ptr, monitor)) };
+		promise.set_value(rvo);
+		auto const bytes{ get_bytes(*rvo) };
+		std::lock_guard<std::mutex> const lock{ mutex_ };
+		auto const it{ entries_.find(key) };
+		if ((it != cend(entries_)) && (it->second.id == id)) {
+			it->second.bytes = bytes;
+			bytes_ += bytes;
+			while ((bytes_ > budget_) && !lru_.empty())
+				erase(entries_.find(lru_.back()));
+		}
+		return rvo;
+	} catch (...) {
+		// Erased before the waiting threads are woken up.
+		{
+			std::lock_guard<std::mutex> const lock{ mutex_ };
+			auto const it{ entries_.find(key) };
+			if ((it != cend(entries_)) && (it->second.id == id))
+				erase(it);
+		}
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+}
+// Parser of a worksheet part: “next_char” returns the next char of the part or -1 at its end. The
+// cells are given to the callback in the document order.
+template<typename NextChar>
+void
+parse_sheet_xml(NextChar&& next_char,
+                Sheet const& sheet,
+                Options const& options,
+                cell_callback_t const& callback)
+{
+	auto const& nmspace{ sheet.nmspace };
+	// Without shared strings, the indexes are given to the callback.
+	auto const shared_strings{ sheet.shared_strings.get() };
+	auto const& styles{ *sheet.styles };
+	str_t iso;
+	auto const push_value{ [&](str_t& ref, str_t& type, str_t& style, str_t& value) {
+		cell_view_t v{};
+		if (!style.empty()) {
+			size_t k{};
+			std::from_chars(style.data(), style.data() + style.size(), k);
+			if (k < styles.size())
+				v.style = styles[k];
+		}
+		// String inline or string result of a formula.
+		if ((type == "inlineStr") || (type == "str")) {
+			value = decode_entities(value);
+			v.kind = cell_view_t::kind_t::string;
+			v.str = value;
 		}
 		// Shared string.
 		else if (type == "s") {
 			auto const i = std::stoi(value);
-			if ((0 <= i) && (size_t(i) < shared_strings.size()))
-				v = shared_strings[i];
-			else
+			if ((0 <= i) && !shared_strings) {
+				v.kind = cell_view_t::kind_t::shared;
+				v.integer = i;
+			} else if ((0 <= i) && (size_t(i) < shared_strings->size())) {
+				v.kind = cell_view_t::kind_t::string;
+				v.str = (*shared_strings)[i];
+			} else
 				throw Exception{ "invalid index for the a shared string (workbook corrupted?)" };
 		} else {
-			if (value.find('.') == str_t::npos) {
-				// Integer: use “stoll” because the size of a “long long int” is at
-				// least 64 bytes.
-				auto const tmp = std::stoll(value);
-				if ((std::numeric_limits<int64_t>::min() <= tmp) &&
-				    (tmp <= std::numeric_limits<int64_t>::max()))
-					v = int64_t(tmp);
-				else
-					v = double(tmp);
-			} else
-				v = std::stod(value);
+			v.kind = cell_view_t::kind_t::text;
+			v.str = value;
 		}
 		size_t i{}, j{};
 		for (auto const& c : ref) {
@@ -448,33 +1671,9 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 		}
 		if ((i == 0) || (j == 0))
 			throw Exception{ "invalid cell ref (workbook corrupted?)" };
-		--i;
-		--j;
-		// rvo.size() == 3 and i == 2 : error
-		// rvo.size() == 2 and i == 2 : do nothing
-		// rvo.size() == 1 and i == 2 : push the current row and clear it
-		// rvo.size() == 0 and i == 2 : push the current row, clear it and add 1
-		// empty row
-		if (rvo.size() > i)
-			throw Exception{ "rows not sorted (workbook corrupted?)" };
-		else if (rvo.size() < i) {
-			rvo.emplace_back(row);
-			row.clear();
-			auto const count = i - rvo.size();
-			for (size_t ii{}; ii < count; ++ii)
-				rvo.emplace_back(row);
-		}
-		// row.size() == 2 and j == 1 : error
-		// row.size() == 1 and j == 1 : push the element on the current row
-		// row.size() == 0 and j == 1 : add an empty cell and push the element
-		if (row.size() > j)
-			throw Exception{ "columns not sorted (workbook corrupted?)" };
-		else {
-			auto const count = j - row.size();
-			for (size_t jj{}; jj < count; ++jj)
-				row.emplace_back(cell_t{});
-			row.emplace_back(v);
-		}
+		if (options.iso_dates)
+			apply_date_style(v, sheet.date1904, iso);
+		callback(i - 1, j - 1, v);
 	} };
 	// Integer value : <c r="A1"> <v>12</v> </c>
 	// Double value : <c r="A1"> <v>1.2</v> </c>
@@ -495,6 +1694,10 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 		te,
 		ted,
 		tes,
+		s,
+		se,
+		sed,
+		ses,
 		u,
 		uu,
 		ue,
@@ -508,7 +1711,7 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 		ntgt,
 	};
 
-	str_t ref, type, value;
+	str_t ref, type, style, value;
 	State state{ State::start };
 
 	for (int c{ next_char() }; c != -1; c = next_char()) {
@@ -550,19 +1753,21 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 				else if (c == '>')
 					state = State::next;
 				else
-					ref.clear(), type.clear(),
+					ref.clear(), type.clear(), style.clear(),
 					  state = State::start; // <c r="xx" t="xx"/> : no value
 				break;
-			// Waiting for attributes “r”, “t” or unknow or for char “>”.
+			// Waiting for attributes “r”, “t”, “s” or unknow or for char “>”.
 			case State::space:
 				if (c == 'r')
 					state = State::r;
 				else if (c == 't')
 					state = State::t;
+				else if (c == 's')
+					state = State::s;
 				else if (c == '>')
 					state = State::next;
 				else if (c == '/')
-					ref.clear(), type.clear(),
+					ref.clear(), type.clear(), style.clear(),
 					  state = State::start; // <c r="xx" t="xx" /> : no value
 				else if (c != ' ')
 					state = State::u;
@@ -627,6 +1832,36 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 				else
 					type += c;
 				break;
+			// Waiting for “=” after the “s” attribute.
+			case State::s:
+				if (c == '=')
+					state = State::se;
+				else
+					state = State::start;
+				break;
+			// Waiting for a single ou a double quote.
+			case State::se:
+				if (c == '"')
+					state = State::sed;
+				else if (c == '\'')
+					state = State::ses;
+				else
+					state = State::start;
+				break;
+			// Waiting for the value of the “s” attribute (the style index) after a double quote.
+			case State::sed:
+				if (c == '"')
+					state = State::c;
+				else
+					style += c;
+				break;
+			// Waiting for the value of the “s” attribute after a single quote.
+			case State::ses:
+				if (c == '\'')
+					state = State::c;
+				else
+					style += c;
+				break;
 			// Waiting for “=” after a unknow attribute.
 			case State::u:
 				if (c == '=')
@@ -693,8 +1928,8 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 			case State::nvgt:
 				if (c == '<') {
 					// YES.
-					push_value(ref, type, value);
-					ref.clear(), type.clear(), value.clear();
+					push_value(ref, type, style, value);
+					ref.clear(), type.clear(), style.clear(), value.clear();
 					state = State::start;
 				} else
 					value += c;
@@ -710,8 +1945,8 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 			case State::ntgt:
 				if (c == '<') {
 					// YES.
-					push_value(ref, type, value);
-					ref.clear(), type.clear(), value.clear();
+					push_value(ref, type, style, value);
+					ref.clear(), type.clear(), style.clear(), value.clear();
 					state = State::start;
 				} else
 					value += c;
@@ -721,10 +1956,182 @@ get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_na
 				throw Exception{ "internal error (should never occur...)" };
 		}
 	}
+}
+void
+parse_sheet(zip_t* archive_ptr,
+            Sheet const& sheet,
+            Options const& options,
+            cell_callback_t const& callback,
+            Monitor& monitor)
+{
+	// The rows are counted only for a monitored read.
+	auto const monitor_ptr{ monitor.active() ? &monitor : nullptr };
+	cell_callback_t const counted{ [&](size_t i, size_t j, cell_view_t const& v) {
+		monitor.cell(i, j);
+		callback(i, j, v);
+	} };
+	auto const& cb{ monitor_ptr ? counted : callback };
+	if (is_bin(sheet.file_name))
+		return parse_sheet_bin(archive_ptr, sheet, options, cb, monitor_ptr);
+	ZipReader reader{ archive_ptr, sheet.file_name, monitor_ptr };
+	parse_sheet_xml([&]() { return reader.next_char(); }, sheet, options, cb);
+}
+void
+parse_sheet(zip_t* archive_ptr,
+            Sheet const& sheet,
+            Options const& options,
+            cell_callback_t const& callback)
+{
+	Monitor monitor{ options };
+	parse_sheet(archive_ptr, sheet, options, callback, monitor);
+}
+str_t
+read_cells(char const* const xlsx_file_name,
+           char const* const sheet_name,
+           Options const& options,
+           cell_callback_t const& callback)
+{
+	auto const zip{ Zip{ xlsx_file_name } };
+	Monitor monitor{ options };
+	auto const sheet{ get_sheet(zip.archive_ptr_, xlsx_file_name, sheet_name, options, monitor) };
+	parse_sheet(zip.archive_ptr_, sheet, options, callback, monitor);
+	return sheet.name;
+}
+str_t
+read_cells(char const* const xlsx_file_name,
+           char const* const sheet_name,
+           cell_callback_t const& callback)
+{
+	return read_cells(xlsx_file_name, sheet_name, Options{}, callback);
+}
+
+table_t
+get_table(zip_t* archive_ptr,
+          Sheet const& sheet,
+          Options const& options,
+          Monitor& monitor,
+          std::vector<std::array<size_t, 3>>& shared)
+{
+	std::vector<std::vector<cell_t>> rvo;
+	std::vector<cell_t> row;
+	auto const budget{ monitor.active() && monitor.limits().memory };
+	parse_sheet(
+	  archive_ptr,
+	  sheet,
+	  options,
+	  [&](size_t i, size_t j, cell_view_t const& v) {
+		  // The rows and the cells appended by push_cell (with the padding) before they are.
+		  if (budget) {
+			  auto const rows{ (i > rvo.size()) ? i - rvo.size() : 0 };
+			  auto const cells{ (rows > 0) ? j + 1 : j + 1 - std::min(j + 1, row.size()) };
+			  monitor.allocate(rows * sizeof(row_t) + cells * sizeof(cell_t) +
+			                   ((v.kind == cell_view_t::kind_t::string) ? v.str.size() : 0) +
+			                   ((v.kind == cell_view_t::kind_t::shared) ? sizeof(shared[0]) : 0));
+		  }
+		  if (v.kind == cell_view_t::kind_t::shared)
+			  shared.push_back({ i, j, size_t(v.integer) });
+		  push_cell(rvo, row, i, j, to_cell(v));
+	  },
+	  monitor);
 	// Do not forget to append the last row !
 	if (!row.empty())
 		rvo.emplace_back(row);
-	return { rvo, sheetname };
+	return rvo;
+}
+table_t
+get_table(zip_t* archive_ptr, Sheet const& sheet, Options const& options, Monitor& monitor)
+{
+	std::vector<std::array<size_t, 3>> shared;
+	return get_table(archive_ptr, sheet, options, monitor, shared);
+}
+table_t
+get_table(zip_t* archive_ptr, Sheet const& sheet, Options const& options)
+{
+	Monitor monitor{ options };
+	return get_table(archive_ptr, sheet, options, monitor);
+}
+std::pair<table_t, str_t>
+get_table_concurrent(zip_t* archive_ptr,
+                     char const* const xlsx_file_name,
+                     char const* const sheet_name,
+                     Options const& options,
+                     Monitor& monitor)
+{
+	auto const monitor_ptr{ monitor.active() ? &monitor : nullptr };
+	if (monitor_ptr)
+		monitor.check_archive(archive_ptr);
+	auto const wb{ get_workbook(archive_ptr, monitor_ptr) };
+	auto const [file_name, name]{ get_sheet_file_name(wb, sheet_name) };
+	auto const styles{ std::make_shared<std::vector<style_kind_t> const>(
+	  wb.styles.empty() ? std::vector<style_kind_t>{}
+	                    : get_styles(archive_ptr, wb.styles, wb.nmspace, monitor_ptr)) };
+	if (wb.shared.empty() || is_bin(file_name)) {
+		auto const shared_strings{ std::make_shared<SharedStrings const>(
+		  wb.shared.empty() ? SharedStrings{}
+		                    : get_shared_strings(archive_ptr, wb.shared, wb.nmspace, monitor_ptr)) };
+		Sheet const sheet{ file_name, name, wb.nmspace, shared_strings, styles, wb.date1904 };
+		return { get_table(archive_ptr, sheet, options, monitor), name };
+	}
+
+	// The shared strings are checked by their own monitor (the progress is only the progress of the
+	// worksheet) and charged to the memory budget of the read once decoded. Their cancellation token
+	// is set when this function exits, so that a failed parse of the worksheet does not wait for the
+	// whole decode; the token of the options is checked by this thread.
+	auto const stop{ std::make_shared<std::atomic<bool>>(false) };
+	auto strings_options{ options };
+	strings_options.progress = nullptr;
+	strings_options.cancel = stop;
+	Monitor strings_monitor{ strings_options };
+	auto strings{ std::async(std::launch::async, [&]() {
+		auto const zip{ Zip{ xlsx_file_name } };
+		return get_shared_strings(zip.archive_ptr_,
+		                          wb.shared,
+		                          wb.nmspace,
+		                          options.threads - 1,
+		                          strings_monitor.active() ? &strings_monitor : nullptr);
+	}) };
+	struct Stop
+	{
+		std::atomic<bool>& flag;
+		~Stop() { flag = true; }
+	} const stop_on_exit{ *stop };
+	Sheet const sheet{ file_name, name, wb.nmspace, nullptr, styles, wb.date1904 };
+	std::vector<std::array<size_t, 3>> shared;
+	auto rvo{ get_table(archive_ptr, sheet, options, monitor, shared) };
+	if (monitor_ptr)
+		while (strings.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready)
+			monitor.check();
+	auto const shared_strings{ strings.get() };
+	if (monitor_ptr)
+		monitor.allocate(shared_strings.pool.size() + shared_strings.offsets.size() * sizeof(size_t));
+	for (auto const& [i, j, k] : shared) {
+		if (k >= shared_strings.size())
+			throw Exception{ "invalid index for the a shared string (workbook corrupted?)" };
+		auto const str{ shared_strings[k] };
+		if (monitor_ptr)
+			monitor.allocate(str.size());
+		rvo[i][j] = str_t{ str };
+	}
+	return { rvo, name };
+}
+
+// Read a sheet and returns a table (vectors of vectors) of variants.
+std::pair<std::vector<std::vector<cell_t>>, str_t>
+get_table_sheetname(char const* const xlsx_file_name,
+                    char const* const sheet_name,
+                    Options const& options)
+{
+	auto const zip{ Zip{ xlsx_file_name } };
+	Monitor monitor{ options };
+	if ((options.threads > 1) && !options.cache)
+		return get_table_concurrent(zip.archive_ptr_, xlsx_file_name, sheet_name, options, monitor);
+	auto const sheet{ get_sheet(zip.archive_ptr_, xlsx_file_name, sheet_name, options, monitor) };
+	return { get_table(zip.archive_ptr_, sheet, options, monitor), sheet.name };
+}
+std::pair<std::vector<std::vector<cell_t>>, str_t>
+get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_name)
+{
+	return get_table_sheetname(xlsx_file_name, sheet_name, Options{});
 }
 std::pair<std::vector<std::vector<cell_t>>, str_t>
 get_table_sheetname(char const* const xlsx_file_name)
@@ -732,6 +2139,11 @@ get_table_sheetname(char const* const xlsx_file_name)
 	return get_table_sheetname(xlsx_file_name, "");
 }
 std::vector<std::vector<cell_t>>
+read(char const* const xlsx_file_name, char const* const sheet_name, Options const& options)
+{
+	return get_table_sheetname(xlsx_file_name, sheet_name, options).first;
+}
+std::vector<std::vector<cell_t>>
 read(char const* const xlsx_file_name, char const* const sheet_name)
 {
 	return get_table_sheetname(xlsx_file_name, sheet_name).first;
@@ -758,6 +2170,11 @@ get_worksheet_names(char const* const xlsx_file_name)
 	return rvo;
 }
 std::vector<std::vector<cell_t>>
+read(str_t const& xlsx_file_name, char const* const sheet_name, Options const& options)
+{
+	return read(xlsx_file_name.c_str(), sheet_name, options);
+}
+std::vector<std::vector<cell_t>>
 read(str_t const& xlsx_file_name, char const* const sheet_name)
 {
 	return read(xlsx_file_name.c_str(), sheet_name);
@@ -767,6 +2184,1290 @@ read(str_t const& xlsx_file_name)
 {
 	return read(xlsx_file_name, "");
 }
+IncrementalReader::IncrementalReader(str_t const& xlsx_file_name, Options const& options)
+  : xlsx_file_name_(xlsx_file_name)
+  , options_(options)
+{}
+IncrementalReader::IncrementalReader(str_t const& xlsx_file_name)
+  : IncrementalReader(xlsx_file_name, Options{})
+{}
+std::map<str_t, table_t> const&
+IncrementalReader::read()
+{
+	auto const zip{ Zip{ xlsx_file_name_.c_str() } };
+	Monitor monitor{ options_ };
+	auto const monitor_ptr{ monitor.active() ? &monitor : nullptr };
+	if (monitor_ptr)
+		monitor.check_archive(zip.archive_ptr_);
+
+	// The CRCs are committed only when all the sheets are read.
+	std::map<str_t, std::pair<uint32_t, uint64_t>> crcs;
+	auto const changed{ [&](str_t const& name) {
+		zip_stat_t st;
+		zip_stat_init(&st);
+		std::pair<uint32_t, uint64_t> crc{};
+		if (zip_stat(zip.archive_ptr_, name.c_str(), 0, &st) == 0)
+			crc = { st.crc, st.size };
+		crcs[name] = crc;
+		auto const it{ crcs_.find(name) };
+		return (it == cend(crcs_)) || (it->second != crc);
+	} };
+
+	// The metadata parts: “_rels/.rels”, the workbook and its relationships.
+	auto wb{ wb_ };
+	auto const wb_part{ [&]() { return wb.wb_base + '/' + wb.wb_name; } };
+	auto const rels_part{ [&]() { return wb.wb_base + "/_rels/" + wb.wb_name + ".rels"; } };
+	auto const metadata{ changed("_rels/.rels") |
+		                   (wb.wb_name.empty() || (changed(wb_part()) | changed(rels_part()))) };
+	if (metadata) {
+		wb = get_workbook(zip.archive_ptr_, monitor_ptr);
+		changed(wb_part());
+		changed(rels_part());
+	}
+
+	// All the sheets are parsed again if the shared strings, the styles or the date system changed.
+	auto shared_strings{ shared_strings_ };
+	auto styles{ styles_ };
+	auto const all{ !shared_strings | changed(wb.shared) | changed(wb.styles) |
+		              (wb.date1904 != wb_.date1904) };
+	if (all) {
+		shared_strings = std::make_shared<SharedStrings const>(
+		  wb.shared.empty() ? SharedStrings{}
+		                    : get_shared_strings(zip.archive_ptr_, wb.shared, wb.nmspace, monitor_ptr));
+		styles = std::make_shared<std::vector<style_kind_t> const>(
+		  wb.styles.empty() ? std::vector<style_kind_t>{}
+		                    : get_styles(zip.archive_ptr_, wb.styles, wb.nmspace, monitor_ptr));
+	}
+
+	std::map<str_t, table_t> tables;
+	std::map<str_t, str_t> files;
+	std::vector<str_t> parsed, kept;
+	for (auto const& p : wb.ids) {
+		auto const [file_name, name]{ get_sheet_file_name(wb, p.first.c_str()) };
+		files[name] = file_name;
+		auto const it_files{ files_.find(name) };
+		if (!changed(file_name) && !all && (it_files != cend(files_)) &&
+		    (it_files->second == file_name)) {
+			kept.push_back(name);
+			continue;
+		}
+		Sheet const sheet{ file_name, name, wb.nmspace, shared_strings, styles, wb.date1904 };
+		tables[name] = get_table(zip.archive_ptr_, sheet, options_, monitor);
+		parsed.push_back(name);
+	}
+
+	for (auto const& name : kept)
+		tables[name] = std::move(tables_[name]);
+	crcs_ = std::move(crcs);
+	wb_ = std::move(wb);
+	shared_strings_ = std::move(shared_strings);
+	styles_ = std::move(styles);
+	files_ = std::move(files);
+	tables_ = std::move(tables);
+	parsed_ = std::move(parsed);
+	return tables_;
+}
+
+// Class for RAII: a reader of a file of the archive, char by char, inflating the raw (deflated)
+// data itself block by block so that the inflate state may be saved at the block boundaries and
+// restored later (a stored file is read as it is).
+class Inflater
+{
+public:
+	// The monitor, if any, is given each chunk inflated.
+	Inflater(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor)
+	  : file_name_(file_name)
+	  , monitor_(monitor)
+	{
+		zip_stat_t st;
+		zip_stat_init(&st);
+		if (zip_stat(archive_ptr, file_name.c_str(), 0, &st) != 0)
+			throw Exception{ "unable to open the “" + file_name + "” file" };
+		stored_ = st.comp_method == ZIP_CM_STORE;
+		if (!stored_ && (st.comp_method != ZIP_CM_DEFLATE))
+			throw Exception{ "unsupported compression method for the “" + file_name + "” file" };
+		file_ptr_ = zip_fopen(archive_ptr, file_name.c_str(), ZIP_FL_COMPRESSED);
+		if (!file_ptr_)
+			throw Exception{ "unable to open the “" + file_name + "” file" };
+		if (!stored_ && (inflateInit2(&strm_, -15) != Z_OK)) {
+			zip_fclose(file_ptr_);
+			throw Exception{ "unable to inflate the “" + file_name + "” file" };
+		}
+		if (monitor_)
+			try {
+				monitor_->open(archive_ptr, file_name);
+			} catch (...) {
+				if (!stored_)
+					inflateEnd(&strm_);
+				zip_fclose(file_ptr_);
+				throw;
+			}
+	}
+	Inflater(Inflater const&) = delete;
+	Inflater& operator=(Inflater const&) = delete;
+	~Inflater()
+	{
+		if (!stored_)
+			inflateEnd(&strm_);
+		zip_fclose(file_ptr_);
+	}
+	// Restart the inflate at an access point (before any char is read).
+	void seek(Checkpoint const& point)
+	{
+		auto const in{ point.in - ((point.bits != 0) ? 1 : 0) };
+		if (zip_fseek(file_ptr_, zip_int64_t(in), SEEK_SET) == 0)
+			read_ = in;
+		else
+			// Not seekable: skip the raw data.
+			while (read_ < in) {
+				auto const n{ zip_fread(
+				  file_ptr_, in_buffer_, std::min<uint64_t>(sizeof(in_buffer_), in - read_)) };
+				if (n <= 0)
+					corrupted();
+				read_ += uint64_t(n);
+			}
+		out_ = point.out;
+		if (stored_)
+			return;
+		if (point.bits != 0) {
+			unsigned char c;
+			if (zip_fread(file_ptr_, &c, 1) != 1)
+				corrupted();
+			++read_;
+			inflatePrime(&strm_, point.bits, c >> (8 - point.bits));
+		}
+		if (!point.window.empty())
+			inflateSetDictionary(&strm_,
+			                     reinterpret_cast<Bytef const*>(point.window.data()),
+			                     uInt(point.window.size()));
+	}
+	// Returns the next char or -1 at the end of the file.
+	int next_char()
+	{
+		if ((i_ == n_) && !fill())
+			return -1;
+		return window_[i_++];
+	}
+	// Offset of the next char in the uncompressed file.
+	uint64_t out() const { return out_ - (n_ - i_); }
+	// True if the next char begins a deflate block (that is not the last one).
+	bool at_boundary() const { return (i_ == n_) && boundary_; }
+	// The access point before the next char (if “at_boundary” after reading from the beginning).
+	Checkpoint checkpoint() const
+	{
+		Checkpoint rvo{ read_ - (stored_ ? 0 : strm_.avail_in), 0, out(), {}, 0, 0 };
+		if (stored_)
+			return rvo;
+		rvo.bits = strm_.data_type & 7;
+		auto const window{ reinterpret_cast<char const*>(window_) };
+		if (wrapped_)
+			rvo.window.assign(window + n_, sizeof(window_) - n_);
+		rvo.window.append(window, n_);
+		return rvo;
+	}
+
+private:
+	[[noreturn]] void corrupted() const
+	{
+		throw Exception{ "unable to inflate the “" + file_name_ + "” file (workbook corrupted?)" };
+	}
+	// The output is written in the window, used as a circular buffer.
+	bool fill()
+	{
+		if (end_)
+			return false;
+		if (n_ == sizeof(window_)) {
+			n_ = i_ = 0;
+			wrapped_ = true;
+		}
+		size_t produced{};
+		if (stored_) {
+			auto const n{ zip_fread(file_ptr_, window_ + n_, sizeof(window_) - n_) };
+			if (n < 0)
+				corrupted();
+			read_ += uint64_t(n);
+			produced = size_t(n);
+			end_ = n == 0;
+			boundary_ = true;
+		}
+		while (!stored_ && (produced == 0) && !end_) {
+			if (strm_.avail_in == 0) {
+				auto const n{ zip_fread(file_ptr_, in_buffer_, sizeof(in_buffer_)) };
+				if (n < 0)
+					corrupted();
+				strm_.next_in = in_buffer_;
+				strm_.avail_in = uInt(n);
+				read_ += uint64_t(n);
+			}
+			strm_.next_out = window_ + n_;
+			strm_.avail_out = uInt(sizeof(window_) - n_);
+			auto const ret{ inflate(&strm_, Z_BLOCK) };
+			if ((ret == Z_NEED_DICT) || (ret == Z_DATA_ERROR) || (ret == Z_MEM_ERROR))
+				corrupted();
+			produced = sizeof(window_) - n_ - strm_.avail_out;
+			end_ = ret == Z_STREAM_END;
+			// No progress without input: the file is truncated.
+			if ((ret == Z_BUF_ERROR) && (strm_.avail_in == 0) && (produced == 0))
+				corrupted();
+			boundary_ = (strm_.data_type & 128) && !(strm_.data_type & 64);
+		}
+		n_ += produced;
+		out_ += produced;
+		if (monitor_ && (produced != 0))
+			monitor_->chunk(produced);
+		return produced != 0;
+	}
+	str_t const file_name_;
+	Monitor* const monitor_;
+	zip_file_t* file_ptr_;
+	bool stored_{}, end_{}, boundary_{}, wrapped_{};
+	z_stream strm_{};
+	unsigned char in_buffer_[16384];
+	unsigned char window_[32768];
+	// Raw bytes read, uncompressed bytes written.
+	uint64_t read_{}, out_{};
+	size_t n_{}, i_{};
+};
+
+SheetIndex::SheetIndex(str_t const& xlsx_file_name,
+                       char const* const sheet_name,
+                       Options const& options)
+  : xlsx_file_name_(xlsx_file_name)
+  , options_(options)
+{
+	auto const zip{ Zip{ xlsx_file_name.c_str() } };
+	sheet_ = get_sheet(zip.archive_ptr_, xlsx_file_name, sheet_name, options);
+	if (is_bin(sheet_.file_name))
+		throw Exception{ "no index for the xlsb sheet “" + sheet_.name + "”" };
+	zip_stat_t st;
+	zip_stat_init(&st);
+	if (zip_stat(zip.archive_ptr_, sheet_.file_name.c_str(), 0, &st) != 0)
+		throw Exception{ "unable to open the “" + sheet_.file_name + "” file" };
+	crc_ = { st.crc, st.size };
+}
+SheetIndex::SheetIndex(str_t const& xlsx_file_name,
+                       char const* const sheet_name,
+                       size_t spacing,
+                       Options const& options)
+  : SheetIndex(xlsx_file_name, sheet_name, options)
+{
+	auto const zip{ Zip{ xlsx_file_name.c_str() } };
+	Monitor monitor{ options_ };
+	auto const monitor_ptr{ monitor.active() ? &monitor : nullptr };
+	Inflater inflater{ zip.archive_ptr_, sheet_.file_name, monitor_ptr };
+	// “<row ” or “<row>”, with the namespace.
+	auto const row_tag{ '<' + ((sheet_.nmspace == "") ? sheet_.nmspace : (sheet_.nmspace + ':')) +
+		                  "row" };
+	size_t matched{}, last_row{};
+	// A checkpoint waiting for its row tag (offset) or for its first cell (row).
+	bool pending_offset{}, pending_row{};
+	parse_sheet_xml(
+	  [&]() {
+		  if (!pending_offset && !pending_row && inflater.at_boundary() &&
+		      (last_row >= (checkpoints_.empty() ? 0 : checkpoints_.back().row) + spacing)) {
+			  checkpoints_.push_back(inflater.checkpoint());
+			  pending_offset = true;
+			  matched = 0;
+		  }
+		  auto const c{ inflater.next_char() };
+		  if (pending_offset) {
+			  if (matched == row_tag.size()) {
+				  if ((c == ' ') || (c == '>') || (c == '\t') || (c == '\n') || (c == '\r')) {
+					  checkpoints_.back().offset = inflater.out() - 1 - row_tag.size();
+					  pending_offset = false;
+					  pending_row = true;
+				  }
+				  matched = 0;
+			  }
+			  if (pending_offset)
+				  matched = (c == row_tag[matched]) ? matched + 1 : ((c == '<') ? 1 : 0);
+		  }
+		  return c;
+	  },
+	  sheet_,
+	  // The values are not used: they are decoded without conversion.
+	  Options{},
+	  [&](size_t i, size_t j, cell_view_t const&) {
+		  if (monitor_ptr)
+			  monitor.cell(i, j);
+		  last_row = i;
+		  if (pending_row) {
+			  checkpoints_.back().row = i;
+			  pending_row = false;
+		  }
+	  });
+	// A checkpoint without row.
+	if (pending_offset || pending_row)
+		checkpoints_.pop_back();
+}
+SheetIndex::SheetIndex(str_t const& xlsx_file_name, char const* const sheet_name, size_t spacing)
+  : SheetIndex(xlsx_file_name, sheet_name, spacing, Options{})
+{}
+// The index file: a magic string, the CRC and the size of the part, the count of the checkpoints
+// and the checkpoints, with the integers in the native byte order.
+char constexpr index_magic[]{ "fd-read-xlsx index 1" };
+SheetIndex
+SheetIndex::load(str_t const& xlsx_file_name,
+                 char const* const sheet_name,
+                 str_t const& index_file_name,
+                 Options const& options)
+{
+	SheetIndex rvo{ xlsx_file_name, sheet_name, options };
+	std::ifstream in{ index_file_name, std::ios::binary };
+	if (!in)
+		throw Exception{ "unable to open the “" + index_file_name + "” index" };
+	auto const get{ [&](auto& v) {
+		if (!in.read(reinterpret_cast<char*>(&v), sizeof(v)))
+			throw Exception{ "unable to read the “" + index_file_name + "” index (file corrupted?)" };
+	} };
+	char magic[sizeof(index_magic)];
+	get(magic);
+	std::pair<uint32_t, uint64_t> crc;
+	get(crc.first);
+	get(crc.second);
+	if (std::memcmp(magic, index_magic, sizeof(magic)) != 0)
+		throw Exception{ "the “" + index_file_name + "” file is not an index" };
+	if (crc != rvo.crc_)
+		throw Exception{ "the “" + index_file_name + "” index is not the index of the “" +
+			               rvo.sheet_.name + "” sheet (or the sheet changed)" };
+	uint64_t count;
+	get(count);
+	for (uint64_t k{}; k < count; ++k) {
+		Checkpoint point{};
+		uint64_t bits, size, row;
+		get(point.in);
+		get(bits);
+		get(point.out);
+		get(size);
+		if (size > 32768)
+			throw Exception{ "unable to read the “" + index_file_name + "” index (file corrupted?)" };
+		point.window.resize(size);
+		if (!in.read(point.window.data(), std::streamsize(size)))
+			throw Exception{ "unable to read the “" + index_file_name + "” index (file corrupted?)" };
+		get(point.offset);
+		get(row);
+		point.bits = int(bits);
+		point.row = size_t(row);
+		rvo.checkpoints_.push_back(std::move(point));
+	}
+	return rvo;
+}
+SheetIndex
+SheetIndex::load(str_t const& xlsx_file_name,
+                 char const* const sheet_name,
+                 str_t const& index_file_name)
+{
+	return load(xlsx_file_name, sheet_name, index_file_name, Options{});
+}
+void
+SheetIndex::save(str_t const& index_file_name) const
+{
+	std::ofstream out{ index_file_name, std::ios::binary };
+	auto const put{ [&](auto const& v) {
+		out.write(reinterpret_cast<char const*>(&v), sizeof(v));
+	} };
+	put(index_magic);
+	put(crc_.first);
+	put(crc_.second);
+	put(uint64_t(checkpoints_.size()));
+	for (auto const& point : checkpoints_) {
+		put(point.in);
+		put(uint64_t(point.bits));
+		put(point.out);
+		put(uint64_t(point.window.size()));
+		out.write(point.window.data(), std::streamsize(point.window.size()));
+		put(point.offset);
+		put(uint64_t(point.row));
+	}
+	if (!out.flush())
+		throw Exception{ "unable to write the “" + index_file_name + "” index" };
+}
+table_t
+SheetIndex::read_rows(size_t first, size_t count) const
+{
+	auto const zip{ Zip{ xlsx_file_name_.c_str() } };
+	zip_stat_t st;
+	zip_stat_init(&st);
+	if ((zip_stat(zip.archive_ptr_, sheet_.file_name.c_str(), 0, &st) != 0) ||
+	    (std::pair<uint32_t, uint64_t>{ st.crc, st.size } != crc_))
+		throw Exception{ "the “" + sheet_.name + "” sheet changed since its index was built" };
+	Monitor monitor{ options_ };
+	auto const monitor_ptr{ monitor.active() ? &monitor : nullptr };
+	Inflater inflater{ zip.archive_ptr_, sheet_.file_name, monitor_ptr };
+
+	// The last checkpoint before the first row.
+	auto const it{ std::upper_bound(
+	  cbegin(checkpoints_), cend(checkpoints_), first, [](size_t row, Checkpoint const& point) {
+		  return row < point.row;
+	  }) };
+	if (it != cbegin(checkpoints_)) {
+		inflater.seek(*std::prev(it));
+		while (inflater.out() < std::prev(it)->offset)
+			if (inflater.next_char() == -1)
+				throw Exception{ "the “" + sheet_.name + "” sheet changed since its index was built" };
+	}
+
+	table_t rvo;
+	row_t row;
+	bool done{};
+	parse_sheet_xml(
+	  [&]() { return done ? -1 : inflater.next_char(); },
+	  sheet_,
+	  options_,
+	  [&](size_t i, size_t j, cell_view_t const& v) {
+		  if (i >= first + count)
+			  done = true;
+		  else if (i >= first) {
+			  // The limits of the rows are the limits of the rows read.
+			  if (monitor_ptr)
+				  monitor.cell(i - first, j);
+			  push_cell(rvo, row, i - first, j, to_cell(v));
+		  }
+	  });
+	// Do not forget to append the last row !
+	if (!row.empty())
+		rvo.emplace_back(row);
+	return rvo;
+}
+LazyTable::LazyTable(char const* const xlsx_file_name,
+                     char const* const sheet_name,
+                     Options const& options)
+  : options_(options)
+{
+	auto const zip{ Zip{ xlsx_file_name } };
+	Monitor monitor{ options };
+	sheet_ = get_sheet(zip.archive_ptr_, xlsx_file_name, sheet_name, options, monitor);
+	if (is_bin(sheet_.file_name))
+		throw Exception{ "no lazy table for the xlsb sheet “" + sheet_.name + "”" };
+	contents_ = ZipReader{ zip.archive_ptr_, sheet_.file_name, monitor.active() ? &monitor : nullptr }
+	              .read_all();
+	if (monitor.active())
+		monitor.allocate(contents_.size());
+
+	// The boundary scan: the <row> tags, with their “r” attribute (or following the previous row),
+	// the <c> tags with a value (not <c .../>), which need their “r” attribute as in a read, and the
+	// </row> tags. The limits of the rows, of the columns and of the cells are checked here.
+	auto const prefix{ (sheet_.nmspace == "") ? sheet_.nmspace : (sheet_.nmspace + ':') };
+	auto const row_tag{ '<' + prefix + "row" };
+	auto const end_row_tag{ "</" + prefix + "row" };
+	auto const c_tag{ '<' + prefix + 'c' };
+	auto const is_tag{ [&](size_t pos, str_t const& tag) {
+		return (contents_.compare(pos, tag.size(), tag) == 0) &&
+		       ((pos + tag.size() == contents_.size()) ||
+		        std::strchr(" \t\n\r/>", contents_[pos + tag.size()]));
+	} };
+	bool open{};
+	size_t row{}, next_row{};
+	// End the span of the open row at “pos”.
+	auto const close{ [&](size_t pos) {
+		if (open && !spans_.empty() && (spans_.back().row == row) &&
+		    (spans_.back().last == spans_.back().first)) {
+			spans_.back().last = cells_.size();
+			cells_.push_back(pos);
+		}
+		open = false;
+	} };
+	for (auto pos{ contents_.find('<') }; pos != str_t::npos; pos = contents_.find('<', pos + 1)) {
+		if (is_tag(pos, c_tag)) {
+			auto const end{ contents_.find('>', pos) };
+			if (end == str_t::npos)
+				break;
+			if (open && (contents_[end - 1] != '/')) {
+				auto const j{ column(pos) };
+				if (monitor.active())
+					monitor.cell(row, j);
+				if (spans_.empty() || (spans_.back().row != row))
+					spans_.push_back({ row, cells_.size(), cells_.size() });
+				cells_.push_back(pos);
+			}
+			pos = end;
+		} else if (is_tag(pos, row_tag)) {
+			close(pos);
+			auto const r{ ref(pos) };
+			if (!r.empty()) {
+				size_t i{};
+				std::from_chars(r.data(), r.data() + r.size(), i);
+				if ((i == 0) || (i <= next_row))
+					throw Exception{ "rows not sorted (workbook corrupted?)" };
+				next_row = i - 1;
+			}
+			row = next_row++;
+			auto const end{ contents_.find('>', pos) };
+			if (end == str_t::npos)
+				break;
+			open = contents_[end - 1] != '/';
+			pos = end;
+		} else if (is_tag(pos, end_row_tag))
+			close(pos);
+	}
+	close(contents_.size());
+	rows_.resize(spans_.size());
+	if (monitor.active())
+		monitor.allocate(cells_.size() * sizeof(size_t) + spans_.size() * sizeof(Span));
+	memory_ = monitor.memory();
+}
+LazyTable::LazyTable(char const* const xlsx_file_name, char const* const sheet_name)
+  : LazyTable(xlsx_file_name, sheet_name, Options{})
+{}
+std::string_view
+LazyTable::ref(size_t pos) const
+{
+	auto const end{ contents_.find('>', pos) };
+	for (auto k{ contents_.find("r=", pos) }; (k != str_t::npos) && (k + 3 < end);
+	     k = contents_.find("r=", k + 1)) {
+		auto const before{ contents_[k - 1] };
+		if ((before != ' ') && (before != '\t') && (before != '\n') && (before != '\r'))
+			continue;
+		auto const last{ contents_.find(contents_[k + 2], k + 3) };
+		if (last > end)
+			break;
+		return std::string_view{ contents_ }.substr(k + 3, last - k - 3);
+	}
+	return {};
+}
+size_t
+LazyTable::column(size_t pos) const
+{
+	size_t j{};
+	for (auto const& c : ref(pos))
+		if (('A' <= c) && (c <= 'Z'))
+			j = 26 * j + size_t(1 + c - 'A');
+	if (j == 0)
+		throw Exception{ "invalid cell ref (workbook corrupted?)" };
+	return j - 1;
+}
+void
+LazyTable::parse(size_t begin, size_t end, cell_callback_t const& callback) const
+{
+	parse_sheet_xml(
+	  [&]() { return (begin < end) ? static_cast<unsigned char>(contents_[begin++]) : -1; },
+	  sheet_,
+	  options_,
+	  callback);
+}
+row_t const&
+LazyTable::operator[](size_t i)
+{
+	static row_t const empty_row;
+	auto const it{ std::lower_bound(
+	  cbegin(spans_), cend(spans_), i, [](Span const& span, size_t row) { return span.row < row; }) };
+	if ((it == cend(spans_)) || (it->row != i))
+		return empty_row;
+	auto& row{ rows_[size_t(it - cbegin(spans_))] };
+	if (!row) {
+		row_t rvo;
+		parse(cells_[it->first], cells_[it->last], [&](size_t, size_t j, cell_view_t const& v) {
+			if (rvo.size() > j)
+				throw Exception{ "columns not sorted (workbook corrupted?)" };
+			rvo.resize(j);
+			rvo.push_back(to_cell(v));
+		});
+		// The decoded rows are charged to the memory budget of the table.
+		if (options_.limits.memory) {
+			auto bytes{ sizeof(row_t) + rvo.size() * sizeof(cell_t) };
+			for (auto const& cell : rvo)
+				if (holds_string(cell))
+					bytes += std::get<str_t>(cell).size();
+			Monitor{ options_ }.allocate(memory_ + bytes);
+			memory_ += bytes;
+		}
+		row = std::make_unique<row_t const>(std::move(rvo));
+		++decoded_;
+	}
+	return *row;
+}
+cell_t
+LazyTable::cell(size_t i, size_t j)
+{
+	auto const it{ std::lower_bound(
+	  cbegin(spans_), cend(spans_), i, [](Span const& span, size_t row) { return span.row < row; }) };
+	if ((it == cend(spans_)) || (it->row != i))
+		return cell_t{};
+	if (auto const& row{ rows_[size_t(it - cbegin(spans_))] }; row)
+		return (j < row->size()) ? (*row)[j] : cell_t{};
+	// The column of each cell from its reference, the cells being sorted.
+	for (auto k{ it->first }; k < it->last; ++k) {
+		auto const column_k{ column(cells_[k]) };
+		if (column_k > j)
+			break;
+		if (column_k == j) {
+			cell_t rvo;
+			parse(cells_[k], cells_[k + 1], [&](size_t, size_t, cell_view_t const& v) {
+				rvo = to_cell(v);
+			});
+			return rvo;
+		}
+	}
+	return cell_t{};
+}
+char constexpr shared_magic[8]{ 'f', 'd', 'x', 'l', 's', 'x', 's', '1' };
+void
+SharedTable::publish(str_t const& name, table_t const& table)
+{
+	SharedHeader header{ {}, table.size(), 0, 0 };
+	for (auto const& row : table) {
+		header.cells += row.size();
+		for (auto const& cell : row)
+			if (holds_string(cell))
+				header.pool += std::get<str_t>(cell).size();
+	}
+	auto const rows_size{ (header.rows + 1) * sizeof(uint64_t) };
+	auto const cells_size{ header.cells * sizeof(SharedCellRecord) };
+	auto const length{ sizeof(SharedHeader) + rows_size + cells_size + header.pool };
+
+	// A new object: the processes attached to the previous one keep it.
+	shm_unlink(name.c_str());
+	auto const fd{ shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644) };
+	if (fd == -1)
+		throw Exception{ "unable to create the “" + name + "” shared memory object" };
+	if (ftruncate(fd, off_t(length)) != 0) {
+		close(fd);
+		shm_unlink(name.c_str());
+		throw Exception{ "unable to size the “" + name + "” shared memory object" };
+	}
+	auto const address{ mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) };
+	close(fd);
+	if (address == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		throw Exception{ "unable to map the “" + name + "” shared memory object" };
+	}
+
+	auto const base{ static_cast<char*>(address) };
+	auto const rows{ reinterpret_cast<uint64_t*>(base + sizeof(SharedHeader)) };
+	auto const cells{ reinterpret_cast<SharedCellRecord*>(base + sizeof(SharedHeader) + rows_size) };
+	auto const pool{ base + sizeof(SharedHeader) + rows_size + cells_size };
+	uint64_t k{}, offset{};
+	for (size_t i{}; i < table.size(); ++i) {
+		rows[i] = k;
+		for (auto const& cell : table[i]) {
+			auto& record{ cells[k++] };
+			record = { 0, 0, uint32_t(cell.index()) };
+			if (holds_string(cell)) {
+				auto const& str{ std::get<str_t>(cell) };
+				if (str.size() > std::numeric_limits<uint32_t>::max()) {
+					munmap(address, length);
+					shm_unlink(name.c_str());
+					throw Exception{ "too long string for the “" + name + "” shared memory object" };
+				}
+				std::memcpy(pool + offset, str.data(), str.size());
+				record.value = offset;
+				record.size = uint32_t(str.size());
+				offset += str.size();
+			} else if (holds_int(cell))
+				record.value = uint64_t(std::get<int64_t>(cell));
+			else
+				std::memcpy(&record.value, &std::get<double>(cell), sizeof(double));
+		}
+	}
+	rows[table.size()] = k;
+	// The magic string is written last: an object being published is not attached.
+	std::memcpy(base, &header, sizeof(header));
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(base, shared_magic, sizeof(shared_magic));
+	munmap(address, length);
+}
+void
+SharedTable::publish(str_t const& name,
+                     char const* const xlsx_file_name,
+                     char const* const sheet_name,
+                     Options const& options)
+{
+	publish(name, read(xlsx_file_name, sheet_name, options));
+}
+void
+SharedTable::unlink(str_t const& name)
+{
+	shm_unlink(name.c_str());
+}
+SharedTable::SharedTable(str_t const& name)
+{
+	auto const fd{ shm_open(name.c_str(), O_RDONLY, 0) };
+	if (fd == -1)
+		throw Exception{ "unable to open the “" + name + "” shared memory object" };
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw Exception{ "unable to get the size of the “" + name + "” shared memory object" };
+	}
+	length_ = size_t(st.st_size);
+	address_ = (length_ < sizeof(SharedHeader))
+	             ? MAP_FAILED
+	             : mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address_ == MAP_FAILED)
+		throw Exception{ "unable to map the “" + name + "” shared memory object" };
+
+	auto const base{ static_cast<char const*>(address_) };
+	header_ = reinterpret_cast<SharedHeader const*>(base);
+	// The magic string (written last by publish) is read first, before the sizes and the data.
+	auto const published{ std::memcmp(header_->magic, shared_magic, sizeof(shared_magic)) == 0 };
+	std::atomic_thread_fence(std::memory_order_acquire);
+	auto const rows_size{ (header_->rows + 1) * sizeof(uint64_t) };
+	auto const cells_size{ header_->cells * sizeof(SharedCellRecord) };
+	if (!published ||
+	    (header_->rows > length_ / sizeof(uint64_t)) ||
+	    (header_->cells > length_ / sizeof(SharedCellRecord)) ||
+	    (header_->pool > length_) ||
+	    (sizeof(SharedHeader) + rows_size + cells_size + header_->pool != length_)) {
+		munmap(const_cast<void*>(address_), length_);
+		throw Exception{ "the “" + name + "” shared memory object is not a published table" };
+	}
+	rows_ = reinterpret_cast<uint64_t const*>(base + sizeof(SharedHeader));
+	cells_ = reinterpret_cast<SharedCellRecord const*>(base + sizeof(SharedHeader) + rows_size);
+	pool_ = base + sizeof(SharedHeader) + rows_size + cells_size;
+}
+SharedTable::~SharedTable()
+{
+	munmap(const_cast<void*>(address_), length_);
+}
+bool
+empty(SharedCell const& cell)
+{
+	return (cell.record->index == 0) && (cell.record->size == 0);
+}
+bool
+holds_string(SharedCell const& cell)
+{
+	return cell.record->index == 0;
+}
+std::string_view
+get_string(SharedCell const& cell)
+{
+	if (!holds_string(cell))
+		throw std::bad_variant_access{};
+	return { cell.pool + cell.record->value, cell.record->size };
+}
+bool
+holds_int(SharedCell const& cell)
+{
+	return cell.record->index == 1;
+}
+int64_t
+get_int(SharedCell const& cell)
+{
+	if (!holds_int(cell))
+		throw std::bad_variant_access{};
+	return int64_t(cell.record->value);
+}
+bool
+holds_double(SharedCell const& cell)
+{
+	return cell.record->index == 2;
+}
+double
+get_double(SharedCell const& cell)
+{
+	if (!holds_double(cell))
+		throw std::bad_variant_access{};
+	double rvo;
+	std::memcpy(&rvo, &cell.record->value, sizeof(rvo));
+	return rvo;
+}
+double
+get_num(SharedCell const& cell)
+{
+	return holds_int(cell) ? double(get_int(cell)) : get_double(cell);
+}
+cell_t
+to_cell(SharedCell const& cell)
+{
+	if (holds_int(cell))
+		return get_int(cell);
+	if (holds_double(cell))
+		return get_double(cell);
+	return str_t{ get_string(cell) };
+}
+str_t
+to_string(SharedCell const& cell)
+{
+	return to_string(to_cell(cell));
+}
+Predicate
+equal(str_t const& column, cell_t const& value)
+{
+	return { column_index(column), value, value };
+}
+Predicate
+between(str_t const& column, cell_t const& min, cell_t const& max)
+{
+	return { column_index(column), min, max };
+}
+Predicate
+at_least(str_t const& column, cell_t const& min)
+{
+	return { column_index(column), min, std::nullopt };
+}
+Predicate
+at_most(str_t const& column, cell_t const& max)
+{
+	return { column_index(column), std::nullopt, max };
+}
+Aggregate
+aggregate(aggregate_t op, str_t const& column)
+{
+	return { op, column_index(column) };
+}
+// The number of a decoded cell (false if the cell is not a number).
+bool
+get_num(cell_view_t const& v, double& d)
+{
+	switch (v.kind) {
+		case cell_view_t::kind_t::string:
+		case cell_view_t::kind_t::shared:
+			return false;
+		case cell_view_t::kind_t::integer:
+			d = double(v.integer);
+			return true;
+		case cell_view_t::kind_t::real:
+			d = v.real;
+			return true;
+		case cell_view_t::kind_t::text:
+			break;
+	}
+	auto const end{ v.str.data() + v.str.size() };
+	auto const [ptr, ec]{ std::from_chars(v.str.data(), end, d) };
+	return (ec == std::errc{}) && (ptr == end);
+}
+// True if the decoded cell satisfies the predicate.
+bool
+satisfies(cell_view_t const& v, Predicate const& p)
+{
+	auto const& bound{ p.min ? *p.min : *p.max };
+	if (holds_string(bound)) {
+		if (v.kind != cell_view_t::kind_t::string)
+			return false;
+		return (!p.min || (std::get<str_t>(*p.min) <= v.str)) &&
+		       (!p.max || (v.str <= std::get<str_t>(*p.max)));
+	}
+	double d;
+	if (!get_num(v, d))
+		return false;
+	return (!p.min || (get_num(*p.min) <= d)) && (!p.max || (d <= get_num(*p.max)));
+}
+query_result_t
+query(char const* const xlsx_file_name,
+      char const* const sheet_name,
+      Query const& q,
+      Options const& options)
+{
+	for (auto const& p : q.where)
+		if ((!p.min && !p.max) || (p.min && p.max && (p.min->index() != p.max->index()) &&
+		                           (holds_string(*p.min) || holds_string(*p.max))))
+			throw Exception{ "invalid predicate" };
+
+	// Predicates and aggregates by column.
+	std::vector<std::vector<size_t>> predicates, aggregates;
+	for (size_t k{}; k < q.where.size(); ++k) {
+		if (predicates.size() <= q.where[k].column)
+			predicates.resize(q.where[k].column + 1);
+		predicates[q.where[k].column].push_back(k);
+	}
+	for (size_t k{}; k < q.select.size(); ++k) {
+		if (aggregates.size() <= q.select[k].column)
+			aggregates.resize(q.select[k].column + 1);
+		aggregates[q.select[k].column].push_back(k);
+	}
+
+	// State of the current row.
+	auto constexpr npos{ std::numeric_limits<size_t>::max() };
+	auto current{ npos };
+	bool rejected{};
+	size_t satisfied{};
+	cell_t key;
+	std::vector<std::optional<double>> values(q.select.size());
+
+	query_result_t rvo;
+	auto const nan{ std::numeric_limits<double>::quiet_NaN() };
+	auto const finish{ [&]() {
+		if ((current == npos) || (current < q.first_row) || rejected ||
+		    (satisfied < q.where.size()))
+			return;
+		auto it{ rvo.find(key) };
+		if (it == cend(rvo)) {
+			std::vector<double> init;
+			for (auto const& a : q.select)
+				init.push_back(((a.op == aggregate_t::min) || (a.op == aggregate_t::max)) ? nan : 0.);
+			it = rvo.emplace(key, std::move(init)).first;
+		}
+		for (size_t k{}; k < q.select.size(); ++k) {
+			auto& r{ it->second[k] };
+			switch (q.select[k].op) {
+				case aggregate_t::count:
+					++r;
+					break;
+				case aggregate_t::sum:
+					if (values[k])
+						r += *values[k];
+					break;
+				case aggregate_t::min:
+					if (values[k] && !(r <= *values[k]))
+						r = *values[k];
+					break;
+				case aggregate_t::max:
+					if (values[k] && !(r >= *values[k]))
+						r = *values[k];
+					break;
+			}
+		}
+	} };
+
+	read_cells(xlsx_file_name, sheet_name, options, [&](size_t i, size_t j, cell_view_t const& v) {
+		if (i != current) {
+			finish();
+			current = i;
+			rejected = false;
+			satisfied = 0;
+			key = cell_t{};
+			std::fill(begin(values), end(values), std::nullopt);
+		}
+		if (rejected || (i < q.first_row))
+			return;
+		if (j < predicates.size())
+			for (auto const k : predicates[j]) {
+				if (!satisfies(v, q.where[k])) {
+					rejected = true;
+					return;
+				}
+				++satisfied;
+			}
+		if (q.group_by && (*q.group_by == j))
+			key = to_cell(v);
+		if (j < aggregates.size())
+			for (auto const k : aggregates[j]) {
+				double d;
+				if (get_num(v, d))
+					values[k] = d;
+			}
+	});
+	finish();
+	return rvo;
+}
+query_result_t
+query(char const* const xlsx_file_name, char const* const sheet_name, Query const& q)
+{
+	return query(xlsx_file_name, sheet_name, q, Options{});
+}
+
+KeyIndex::KeyIndex(table_t const& table, str_t const& column, size_t first_row)
+{
+	auto const j{ column_index(column) };
+	std::vector<std::pair<uint32_t, size_t>> entries;
+	for (auto i{ first_row }; i < table.size(); ++i)
+		if (j < table[i].size())
+			insert(i, table[i][j], entries);
+	build(entries);
+}
+KeyIndex::KeyIndex(char const* const xlsx_file_name,
+                   char const* const sheet_name,
+                   str_t const& column,
+                   size_t first_row,
+                   Options const& options)
+{
+	auto const column_j{ column_index(column) };
+	std::vector<std::pair<uint32_t, size_t>> entries;
+	read_cells(xlsx_file_name, sheet_name, options, [&](size_t i, size_t j, cell_view_t const& v) {
+		if ((j == column_j) && (i >= first_row))
+			insert(i, to_cell(v), entries);
+	});
+	build(entries);
+}
+KeyIndex::KeyIndex(char const* const xlsx_file_name,
+                   char const* const sheet_name,
+                   str_t const& column,
+                   size_t first_row)
+  : KeyIndex(xlsx_file_name, sheet_name, column, first_row, Options{})
+{}
+bool
+KeyIndex::probe(cell_t const& cell, Probe& p)
+{
+	p.string = holds_string(cell);
+	if (p.string) {
+		p.str = std::get<str_t>(cell);
+		p.hash = std::hash<std::string_view>{}(p.str);
+		return !p.str.empty();
+	}
+	// -0. and 0. are the same key.
+	p.num = get_num(cell) + 0.;
+	p.hash = std::hash<double>{}(p.num);
+	return true;
+}
+size_t
+KeyIndex::slot(Probe const& p) const
+{
+	auto const mask{ slots_.size() - 1 };
+	for (auto k{ size_t(p.hash) & mask };; k = (k + 1) & mask) {
+		if (slots_[k] == 0)
+			return k;
+		auto const& key{ keys_[slots_[k] - 1] };
+		if ((key.hash == p.hash) && (p.string == (key.str != str_t::npos)) &&
+		    (p.string ? (strings_[key.str] == p.str) : (key.num == p.num)))
+			return k;
+	}
+}
+KeyIndex::Key const*
+KeyIndex::lookup(cell_t const& key) const
+{
+	Probe p{};
+	if (slots_.empty() || !probe(key, p))
+		return nullptr;
+	auto const k{ slots_[slot(p)] };
+	return (k == 0) ? nullptr : &keys_[k - 1];
+}
+void
+KeyIndex::insert(size_t i, cell_t const& cell, std::vector<std::pair<uint32_t, size_t>>& entries)
+{
+	Probe p{};
+	if (!probe(cell, p))
+		return;
+	// At most half of the slots are used.
+	if (2 * (keys_.size() + 1) > slots_.size()) {
+		slots_.assign(std::max(size_t{ 16 }, 2 * slots_.size()), 0);
+		for (size_t k{}; k < keys_.size(); ++k) {
+			auto const mask{ slots_.size() - 1 };
+			auto s{ size_t(keys_[k].hash) & mask };
+			while (slots_[s] != 0)
+				s = (s + 1) & mask;
+			slots_[s] = uint32_t(k + 1);
+		}
+	}
+	auto const s{ slot(p) };
+	if (slots_[s] == 0) {
+		auto str{ str_t::npos };
+		if (p.string) {
+			str = strings_.size();
+			strings_.pool += p.str;
+			strings_.push();
+		}
+		keys_.push_back({ p.hash, p.num, str, 0, 0 });
+		slots_[s] = uint32_t(keys_.size());
+	}
+	// The count of rows of the key, made a range by build.
+	++keys_[slots_[s] - 1].last;
+	entries.emplace_back(slots_[s] - 1, i);
+}
+void
+KeyIndex::build(std::vector<std::pair<uint32_t, size_t>> const& entries)
+{
+	size_t first{};
+	for (auto& key : keys_) {
+		duplicates_ += (key.last > 1);
+		key.first = first;
+		first += key.last;
+		key.last = key.first;
+	}
+	rows_.resize(entries.size());
+	for (auto const& [k, i] : entries)
+		rows_[keys_[k].last++] = i;
+}
+std::optional<size_t>
+KeyIndex::find(cell_t const& key) const
+{
+	auto const k{ lookup(key) };
+	if (!k)
+		return std::nullopt;
+	return rows_[k->first];
+}
+std::vector<size_t>
+KeyIndex::rows(cell_t const& key) const
+{
+	auto const k{ lookup(key) };
+	if (!k)
+		return {};
+	return { cbegin(rows_) + k->first, cbegin(rows_) + k->last };
+}
+size_t
+KeyIndex::count(cell_t const& key) const
+{
+	auto const k{ lookup(key) };
+	return k ? k->last - k->first : 0;
+}
+std::vector<cell_t>
+KeyIndex::duplicates() const
+{
+	std::vector<cell_t> rvo;
+	rvo.reserve(duplicates_);
+	for (auto const& key : keys_)
+		if (key.last - key.first > 1) {
+			if (key.str == str_t::npos)
+				rvo.push_back(get_number(key.num));
+			else
+				rvo.push_back(str_t{ strings_[key.str] });
+		}
+	return rvo;
+}
+
+// Arrow export: the private data of a schema owns its strings and its children, the private data of
+// an array owns its buffers and its children.
+struct ArrowSchemaData
+{
+	str_t format, name;
+	std::vector<ArrowSchema*> children;
+};
+struct ArrowArrayData
+{
+	std::vector<std::vector<uint8_t>> buffers;
+	std::vector<void const*> pointers;
+	std::vector<ArrowArray*> children;
+};
+void
+release_arrow_schema(ArrowSchema* schema)
+{
+	auto const data{ static_cast<ArrowSchemaData*>(schema->private_data) };
+	for (auto const child : data->children) {
+		if (child->release)
+			child->release(child);
+		delete child;
+	}
+	delete data;
+	schema->release = nullptr;
+}
+void
+release_arrow_array(ArrowArray* array)
+{
+	auto const data{ static_cast<ArrowArrayData*>(array->private_data) };
+	for (auto const child : data->children) {
+		if (child->release)
+			child->release(child);
+		delete child;
+	}
+	delete data;
+	array->release = nullptr;
+}
+void
+init_arrow_schema(ArrowSchema* schema, str_t const& format, str_t const& name, int64_t flags)
+{
+	auto const data{ new ArrowSchemaData{ format, name, {} } };
+	*schema = ArrowSchema{ data->format.c_str(),
+		                     data->name.c_str(),
+		                     nullptr,
+		                     flags,
+		                     0,
+		                     nullptr,
+		                     nullptr,
+		                     &release_arrow_schema,
+		                     data };
+}
+// The array of the column “j” of the rows [first, table.size()).
+void
+init_arrow_column(table_t const& table,
+                  size_t first,
+                  size_t j,
+                  str_t const& name,
+                  ArrowSchema* schema,
+                  ArrowArray* array)
+{
+	auto const length{ table.size() - first };
+	bool all_int{ true }, all_num{ true };
+	for (auto i{ first }; i < table.size(); ++i)
+		if (!empty(table[i], j)) {
+			all_int = all_int && holds_int(table[i][j]);
+			all_num = all_num && holds_num(table[i][j]);
+		}
+	init_arrow_schema(schema, all_int ? "l" : (all_num ? "g" : "u"), name, ARROW_FLAG_NULLABLE);
+
+	auto data{ std::make_unique<ArrowArrayData>() };
+	auto& buffers{ data->buffers };
+	buffers.resize(all_num ? 2 : 3);
+	buffers[0].assign((length + 7) / 8, 0);
+	if (all_num)
+		buffers[1].resize(8 * length);
+	else
+		buffers[1].resize(4 * (length + 1));
+	int64_t null_count{};
+	int32_t offset{};
+	for (size_t k{}; k < length; ++k) {
+		auto const& row{ table[first + k] };
+		auto const valid{ !empty(row, j) };
+		if (valid)
+			buffers[0][k / 8] |= uint8_t(1 << (k % 8));
+		else
+			++null_count;
+		if (all_int) {
+			auto const v{ valid ? get_int(row[j]) : int64_t{} };
+			std::memcpy(&buffers[1][8 * k], &v, 8);
+		} else if (all_num) {
+			auto const v{ valid ? get_num(row[j]) : 0. };
+			std::memcpy(&buffers[1][8 * k], &v, 8);
+		} else {
+			std::memcpy(&buffers[1][4 * k], &offset, 4);
+			if (valid) {
+				str_t str;
+				if (holds_double(row[j])) {
+					// The shortest text read back as the same double (to_string keeps 6 digits).
+					char buffer[32];
+					auto const end{ std::to_chars(buffer, buffer + sizeof(buffer), get_double(row[j])).ptr };
+					str.assign(buffer, end);
+				} else
+					str = holds_string(row[j]) ? get_string(row[j]) : to_string(row[j]);
+				if (str.size() > size_t(std::numeric_limits<int32_t>::max() - offset))
+					throw Exception{ "too many chars for an utf8 Arrow array in the column " +
+						               column_ref(j) };
+				buffers[2].insert(cend(buffers[2]), cbegin(str), cend(str));
+				offset += int32_t(str.size());
+			}
+		}
+	}
+	if (!all_num)
+		std::memcpy(&buffers[1][4 * length], &offset, 4);
+	for (auto const& buffer : buffers)
+		data->pointers.push_back(buffer.data());
+	// The validity bitmap may be omitted without null.
+	if (null_count == 0)
+		data->pointers[0] = nullptr;
+	*array = ArrowArray{ int64_t(length),
+		                   null_count,
+		                   0,
+		                   int64_t(buffers.size()),
+		                   0,
+		                   data->pointers.data(),
+		                   nullptr,
+		                   nullptr,
+		                   &release_arrow_array,
+		                   data.release() };
+}
+void
+export_arrow(table_t const& table, bool header, ArrowSchema* schema, ArrowArray* array)
+{
+	size_t const first{ (header && !table.empty()) ? 1u : 0u };
+	size_t columns{};
+	for (auto const& row : table)
+		columns = std::max(columns, row.size());
+
+	init_arrow_schema(schema, "+s", "", 0);
+	auto const schema_data{ static_cast<ArrowSchemaData*>(schema->private_data) };
+	auto const array_data{ new ArrowArrayData };
+	array_data->pointers.push_back(nullptr);
+	*array = ArrowArray{ int64_t(table.size() - first),
+		                   0,
+		                   0,
+		                   1,
+		                   0,
+		                   array_data->pointers.data(),
+		                   nullptr,
+		                   nullptr,
+		                   &release_arrow_array,
+		                   array_data };
+	try {
+		for (size_t j{}; j < columns; ++j) {
+			schema_data->children.push_back(new ArrowSchema{});
+			array_data->children.push_back(new ArrowArray{});
+			init_arrow_column(table,
+			                  first,
+			                  j,
+			                  (header && !empty(table[0], j)) ? to_string(table[0][j]) : column_ref(j),
+			                  schema_data->children.back(),
+			                  array_data->children.back());
+		}
+	} catch (...) {
+		schema->release(schema);
+		array->release(array);
+		throw;
+	}
+	schema->n_children = int64_t(columns);
+	schema->children = schema_data->children.data();
+	array->n_children = int64_t(columns);
+	array->children = array_data->children.data();
+}
 std::map<std::string, size_t>
 names(std::vector<cell_t> const& v)
 {
@@ -829,5 +3530,69 @@ to_string(cell_t const& cell)
 	std::visit([&](auto&& arg) { out << arg; }, cell);
 	return out.str();
 }
+// A number is an int64_t if it has no fractional part, as in a xlsx workbook where such a number is
+// written without a dot.
+cell_t
+get_number(double d)
+{
+	if ((std::trunc(d) == d) && (-9.2e18 < d) && (d < 9.2e18))
+		return int64_t(d);
+	return d;
+}
+bool
+is_column_ref(str_t const& column)
+{
+	return !column.empty() && (column.size() <= 3) &&
+	       std::all_of(cbegin(column), cend(column), [](char c) { return ('A' <= c) && (c <= 'Z'); });
+}
+size_t
+column_index(str_t const& column)
+{
+	if (!is_column_ref(column))
+		throw Exception{ "invalid column reference “" + column + "”" };
+	size_t j{};
+	for (auto const& c : column)
+		j = 26 * j + size_t(1 + c - 'A');
+	return j - 1;
+}
+str_t
+column_ref(size_t j)
+{
+	str_t rvo;
+	for (++j; j > 0; j = (j - 1) / 26)
+		rvo.insert(cbegin(rvo), char('A' + (j - 1) % 26));
+	return rvo;
+}
+cell_t
+to_cell(cell_view_t const& v)
+{
+	switch (v.kind) {
+		case cell_view_t::kind_t::string:
+			return str_t{ v.str };
+		// Resolved by the caller.
+		case cell_view_t::kind_t::shared:
+			return cell_t{};
+		case cell_view_t::kind_t::integer:
+			return v.integer;
+		case cell_view_t::kind_t::real:
+			return get_number(v.real);
+		case cell_view_t::kind_t::text:
+			break;
+	}
+	auto const end{ v.str.data() + v.str.size() };
+	if (v.str.find('.') == std::string_view::npos) {
+		// Integer (or a double without a dot as “1E+20”).
+		int64_t i;
+		auto const [ptr, ec]{ std::from_chars(v.str.data(), end, i) };
+		if ((ec == std::errc{}) && (ptr == end))
+			return i;
+	}
+	double d;
+	auto const [ptr, ec]{ std::from_chars(v.str.data(), end, d) };
+	if ((ec == std::errc{}) && (ptr == end))
+		return d;
+	// Not a number (an error as “#N/A” for example).
+	return str_t{ v.str };
+}
 } // namespace fd_read_xlsx
 #endif // FD_READ_XLSX_HEADER_ONLY_HPP
@@ -2,24 +2,146 @@
 #define FD_READ_XLSX_HPP
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 #include <zip.h>
 
 #define FD_READ_XLSX_SHOW(arg) std::cout << #arg << '{' << (arg) << '}' << std::endl;
 
+// Arrow C Data Interface (https://arrow.apache.org/docs/format/CDataInterface.html), defined as
+// in the Arrow sources so that both definitions may coexist.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+struct ArrowSchema
+{
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+	void (*release)(struct ArrowSchema*);
+	void* private_data;
+};
+
+struct ArrowArray
+{
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+	void (*release)(struct ArrowArray*);
+	void* private_data;
+};
+}
+
+#endif // ARROW_C_DATA_INTERFACE
+
 namespace fd_read_xlsx {
 
 typedef std::string str_t;
 
+class Exception : public std::exception
+{
+public:
+	Exception(str_t const& msg)
+	  : msg_("fd-read-xslx library: " + msg + '.')
+	{}
+	const char* what() const throw() { return msg_.c_str(); }
+
+private:
+	str_t const msg_;
+};
+// Thrown when the cancellation token of the options is set during a read.
+class Cancelled : public Exception
+{
+public:
+	using Exception::Exception;
+};
+// Thrown when the deadline of the options is passed during a read.
+class DeadlineExceeded : public Exception
+{
+public:
+	using Exception::Exception;
+};
+// Thrown when a limit of the options is exceeded during a read: a distinct class by limit.
+class LimitExceeded : public Exception
+{
+public:
+	using Exception::Exception;
+};
+class UncompressedSizeExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+class CompressionRatioExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+class RowsLimitExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+class ColumnsLimitExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+class CellsLimitExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+class SharedStringsLimitExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+class MemoryLimitExceeded : public LimitExceeded
+{
+public:
+	using LimitExceeded::LimitExceeded;
+};
+
 // Representation of a cell: std::variant of string, int64_t and double. A int64_t is choosen for
 // int: the size is like the size of a double.
 typedef std::variant<str_t, int64_t, double> cell_t;
@@ -30,6 +152,234 @@ typedef std::vector<std::vector<cell_t>> table_t;
 // A row of this table.
 typedef std::vector<cell_t> row_t;
 
+// The shared strings of a workbook, stored in one contiguous pool: the string “i” is the range
+// [offsets[i], offsets[i + 1]) of the pool.
+struct SharedStrings
+{
+	str_t pool;
+	std::vector<size_t> offsets{ 0 };
+	size_t size() const { return offsets.size() - 1; }
+	std::string_view operator[](size_t i) const
+	{
+		return std::string_view{ pool }.substr(offsets[i], offsets[i + 1] - offsets[i]);
+	}
+	// End the string appended to the pool.
+	void push() { offsets.push_back(pool.size()); }
+};
+
+// Kind of the number format of a cell style: a time is a time of the day, an elapsed time (the
+// [h], [mm] or [ss] formats) may be greater than 24 hours.
+enum class style_kind_t
+{
+	number,
+	date,
+	time,
+	datetime,
+	percent,
+	elapsed,
+};
+
+// Limits of a read, 0 for no limit.
+struct Limits
+{
+	// Uncompressed size and compression ratio of each part, the metadata parts included: checked
+	// against the sizes given by the archive directory before anything is inflated, then against
+	// the bytes really inflated.
+	uint64_t uncompressed_bytes{};
+	double compression_ratio{};
+	// Rows and columns (the indices of the cells), cells parsed.
+	size_t rows{};
+	size_t columns{};
+	uint64_t cells{};
+	// Size of the shared strings pool.
+	uint64_t shared_strings_bytes{};
+	// Approximate memory of the shared strings and of the table built.
+	uint64_t memory{};
+};
+
+// Options of the read functions.
+struct Options
+{
+	// Convert the numbers with a date, time or datetime style into ISO 8601 strings (“2020-05-29”,
+	// “19:01:00” or “2020-05-29T19:01:00”) while the cells are decoded.
+	bool iso_dates{ false };
+	// Take the metadata, the shared strings and the styles of the workbook from the process-wide
+	// cache (see Cache) instead of reading them again.
+	bool cache{ false };
+	// Checked at each chunk read from the archive (and while the workbook is decoded by another read
+	// of the cache): the read is stopped by a Cancelled exception once the token is set or by a
+	// DeadlineExceeded exception after the deadline.
+	std::shared_ptr<std::atomic<bool> const> cancel{};
+	std::optional<std::chrono::steady_clock::time_point> deadline{};
+	// Called at each chunk read from the archive with the bytes inflated and the rows parsed so far.
+	std::function<void(uint64_t bytes, size_t rows)> progress{};
+	Limits limits{};
+	// Number of threads decoding the shared strings, split at their <si> tags. With more than one
+	// thread, read decodes them while it parses the worksheet (0 or 1: a serial decode before it).
+	unsigned threads{ 0 };
+};
+
+// Monitor of a read: checks the cancellation token, the deadline and the limits of the options and
+// reports the progress at each chunk read from the archive.
+class Monitor
+{
+public:
+	explicit Monitor(Options const& options);
+	bool active() const { return active_; }
+	Limits const& limits() const { return options_.limits; }
+	// Check the sizes of all the parts of the archive, as given by its directory.
+	void check_archive(zip_t* archive_ptr);
+	// The part “file_name” is opened: the next chunks are its chunks.
+	void open(zip_t* archive_ptr, str_t const& file_name);
+	// A chunk of “bytes” bytes was read (inflated).
+	void chunk(size_t bytes);
+	// Check the cancellation token and the deadline.
+	void check() const;
+	// A cell of the row “i” and the column “j” was parsed.
+	void cell(size_t i, size_t j)
+	{
+		rows_ = std::max(rows_, i + 1);
+		++cells_;
+		auto const& limits{ options_.limits };
+		if ((limits.rows && (i >= limits.rows)) || (limits.columns && (j >= limits.columns)) ||
+		    (limits.cells && (cells_ > limits.cells)))
+			cell_limit_exceeded(i, j);
+	}
+	// The shared strings pool has now “bytes” bytes (“pool” bytes for the pool itself).
+	void strings(uint64_t pool, uint64_t bytes)
+	{
+		if ((pool > strings_limit_) || (memory_ + bytes > memory_limit_))
+			strings_limit_exceeded(pool);
+	}
+	// The bytes allocated so far.
+	uint64_t memory() const { return memory_; }
+	// “bytes” bytes are allocated.
+	void allocate(uint64_t bytes)
+	{
+		memory_ += bytes;
+		if (options_.limits.memory && (memory_ > options_.limits.memory))
+			throw MemoryLimitExceeded{ "memory limit exceeded" };
+	}
+
+private:
+	[[noreturn]] void cell_limit_exceeded(size_t i, size_t j) const;
+	[[noreturn]] void strings_limit_exceeded(uint64_t pool) const;
+	void check_part(str_t const& file_name, uint64_t size, uint64_t comp_size) const;
+	Options const& options_;
+	bool const active_;
+	// The limits of the shared strings and of the memory (the max without limit).
+	uint64_t const strings_limit_, memory_limit_;
+	uint64_t bytes_{}, cells_{}, memory_{};
+	size_t rows_{};
+	// The current part: its name, its compressed size and the bytes inflated.
+	str_t part_;
+	uint64_t part_comp_size_{}, part_bytes_{};
+};
+
+// A cell as it is decoded by the parsers, before its conversion: a string (entities decoded), the
+// text of a number (xlsx workbook) or a number (xlsb workbook). “str” is only valid during the call
+// of the callback receiving the cell. A sheet parsed without its shared strings (they are decoded
+// on other threads) gives the index of its shared strings in “integer”, with the “shared” kind.
+struct cell_view_t
+{
+	enum class kind_t
+	{
+		string,
+		text,
+		integer,
+		real,
+		shared,
+	};
+	kind_t kind;
+	std::string_view str;
+	int64_t integer;
+	double real;
+	style_kind_t style;
+};
+
+// Callback receiving the cells of a sheet in the document order, with their row “i” and their
+// column “j” (0 based).
+typedef std::function<void(size_t i, size_t j, cell_view_t const& v)> cell_callback_t;
+
+// The metadata of a workbook: its parts and its sheets.
+struct Workbook
+{
+	// Workbook base and name (“xl” and “workbook.xml”).
+	str_t wb_base;
+	str_t wb_name;
+	// Worksheets base, map of the rid and the file name of the worksheets, shared strings part.
+	str_t ws_base;
+	std::map<str_t, str_t> ws_names;
+	str_t shared;
+	// Namespace, map of the sheet name and the rid of the worksheets, active sheet.
+	str_t nmspace;
+	std::map<str_t, str_t> ids;
+	str_t active;
+	// Styles part, and the 1904 date system instead of the 1900 one.
+	str_t styles;
+	bool date1904{};
+};
+
+// A decoded workbook: its metadata, its shared strings and its styles.
+struct WorkbookData
+{
+	Workbook wb;
+	std::shared_ptr<SharedStrings const> shared_strings;
+	std::shared_ptr<std::vector<style_kind_t> const> styles;
+};
+
+// Process-wide LRU cache of the decoded workbooks, keyed by the path, the device, the inode, the
+// modification time and the size of the file, within a budget in bytes. The entries are shared:
+// an evicted entry is freed by its last user. A workbook being decoded by a thread is waited for
+// by the other threads asking for it, so that a single copy is decoded. Thread safe.
+class Cache
+{
+public:
+	static Cache& instance();
+	// The budget (64 MiB by default): the least recently used entries are evicted beyond it.
+	void set_budget(size_t bytes);
+	// The count of entries and their size in bytes.
+	size_t size() const;
+	size_t bytes() const;
+	void clear();
+	// The decoded workbook “xlsx_file_name”, opened as “archive_ptr” on a miss.
+	std::shared_ptr<WorkbookData const> get(str_t const& xlsx_file_name,
+	                                        zip_t* archive_ptr,
+	                                        Monitor* monitor);
+
+private:
+	Cache() = default;
+	typedef std::tuple<str_t, uint64_t, uint64_t, int64_t, uint64_t> Key;
+	struct Entry
+	{
+		std::shared_future<std::shared_ptr<WorkbookData const>> data;
+		// Id of the thread decoding the entry and size of the entry (0 while it is decoded).
+		uint64_t id;
+		size_t bytes;
+		std::list<Key>::iterator lru;
+	};
+	void erase(std::map<Key, Entry>::iterator it);
+	mutable std::mutex mutex_;
+	size_t budget_{ size_t{ 64 } << 20 }, bytes_{};
+	uint64_t id_{};
+	// The keys from the most recently used.
+	std::list<Key> lru_;
+	std::map<Key, Entry> entries_;
+};
+
+// The parts to read for a sheet. The shared strings and the styles are shared by all the sheets of
+// a workbook.
+struct Sheet
+{
+	str_t file_name;
+	str_t name;
+	str_t nmspace;
+	std::shared_ptr<SharedStrings const> shared_strings;
+	// Kind of each style (the index is the “s” attribute of the cells).
+	std::shared_ptr<std::vector<style_kind_t> const> styles;
+	bool date1904{};
+};
+
 // This function returns the value of the attribute “attr” of the tag “tag” in the “str” string from
 // “pos”. This function returns [value, pos, end, error].  “end” is true if the tag is not found.
 // “error” is true if the tag is found but if the closed quote is not found. “pos” is the new
@@ -46,30 +396,195 @@ str_t
 get_contents(zip_t* archive_ptr, char const* const file_name);
 str_t
 get_contents(zip_t* archive_ptr, str_t const& file_name);
+// Same as get_contents, the monitor (if any) being given each chunk read.
+str_t
+get_contents(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor);
 void
 replace_all(str_t& str, str_t that, char c);
-// Get the shared strings in the xml file from a Microsoft xlsx workbook.  We only concatenate the
-// text between <t ...> and </t> tags within <si> and </si> tags to populate the vector.
-std::vector<str_t>
+// Append the UTF-8 encoding of the code point “u” to “str”.
+void
+append_utf8(str_t& str, uint32_t u);
+// Append the decoded value of the entity “&name;” to “str” (predefined entities and numeric
+// character references). Unknown entities are appended as they are.
+void
+append_entity(str_t& str, str_t const& name);
+// Decode all the entities of a xml text in one pass.
+str_t
+decode_entities(str_t const& text);
+// Get the shared strings in the xml file from a Microsoft xlsx workbook. The part is read in one
+// pass, without loading it in memory: we only concatenate the text between <t ...> and </t> tags
+// within <si> and </si> tags (except the phonetic runs within <rPh> tags) to populate the pool.
+SharedStrings
+get_shared_strings(zip_t* archive_ptr,
+                   str_t const& file_name,
+                   str_t const& nmspace,
+                   Monitor* monitor);
+SharedStrings
 get_shared_strings(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace);
+// Same as get_shared_strings but the part is loaded in memory and split at its <si> tags into
+// “threads” pieces, decoded concurrently into their own pools and concatenated in order (so the
+// indexes are kept). A binary part is decoded serially.
+SharedStrings
+get_shared_strings(zip_t* archive_ptr,
+                   str_t const& file_name,
+                   str_t const& nmspace,
+                   unsigned threads,
+                   Monitor* monitor);
 
 // This function returns the tuple of the xml namespace, the map of (sheet ids, sheet names) and
-// active sheet name.
+// active sheet name, and sets “date1904” if the workbook uses the 1904 date system.
+std::tuple<str_t, std::map<str_t, str_t>, str_t>
+get_ns_ids_and_active(zip_t* archive_ptr,
+                      str_t const& wb_base,
+                      str_t const& wb_name,
+                      bool& date1904,
+                      Monitor* monitor);
 std::tuple<str_t, std::map<str_t, str_t>, str_t>
 get_ns_ids_and_active(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name);
 // For debug.
-std::vector<str_t>
+SharedStrings
 get_shared_strings(char const* const xlsx_file_name);
 std::pair<str_t, str_t>
+get_wb_base_and_name(zip_t* archive_ptr, Monitor* monitor);
+std::pair<str_t, str_t>
 get_wb_base_and_name(zip_t* archive_ptr);
+// This function returns the tuple of the worksheets base, the map of (rid, worksheet file names)
+// and the shared strings part, and sets “styles” to the styles part (empty if there is none).
+std::tuple<str_t, std::map<str_t, str_t>, str_t>
+get_ws_and_shared(zip_t* archive_ptr,
+                  str_t const& wb_base,
+                  str_t const& wb_name,
+                  str_t& styles,
+                  Monitor* monitor);
 std::tuple<str_t, std::map<str_t, str_t>, str_t>
 get_ws_and_shared(zip_t* archive_ptr, str_t const& wb_base, str_t const& wb_name);
+// True if the part is a BIFF12 binary part of a xlsb workbook (“workbook.bin”, “sheet1.bin”...).
+bool
+is_bin(str_t const& file_name);
+// Same as get_ns_ids_and_active for a binary workbook part (the namespace is always empty).
+std::tuple<str_t, std::map<str_t, str_t>, str_t>
+get_ids_and_active_bin(zip_t* archive_ptr,
+                       str_t const& wb_base,
+                       str_t const& wb_name,
+                       bool& date1904,
+                       Monitor* monitor);
+// Same as get_shared_strings for a binary shared strings part.
+SharedStrings
+get_shared_strings_bin(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor);
+// Append the value “v” at the row “i” and the column “j” (0 based) of a table being built. “row” is
+// the current row, not yet appended to “rvo”.
+void
+push_cell(table_t& rvo, row_t& row, size_t i, size_t j, cell_t&& v);
+// Parse a binary worksheet part.
+void
+parse_sheet_bin(zip_t* archive_ptr,
+                Sheet const& sheet,
+                Options const& options,
+                cell_callback_t const& callback,
+                Monitor* monitor);
+// Kind of a number format from its id and its code (for the custom formats).
+style_kind_t
+get_format_kind(size_t id, str_t const& code);
+// Get the kind of each style of the styles part, read once in a flat table.
+std::vector<style_kind_t>
+get_styles(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace, Monitor* monitor);
+std::vector<style_kind_t>
+get_styles(zip_t* archive_ptr, str_t const& file_name, str_t const& nmspace);
+std::vector<style_kind_t>
+get_styles_bin(zip_t* archive_ptr, str_t const& file_name, Monitor* monitor);
+// Convert an Excel serial date into an ISO 8601 string.
+str_t
+serial_to_iso(double serial, style_kind_t kind, bool date1904);
+// Convert in place a number with a date, time or datetime style into a string stored in “buffer”.
+void
+apply_date_style(cell_view_t& v, bool date1904, str_t& buffer);
+// Read the metadata parts of a workbook.
+Workbook
+get_workbook(zip_t* archive_ptr, Monitor* monitor);
+Workbook
+get_workbook(zip_t* archive_ptr);
+// Get the part name and the name of the requested sheet (the active sheet if “sheet_name” is
+// empty).
+std::pair<str_t, str_t>
+get_sheet_file_name(Workbook const& wb, char const* const sheet_name);
+// Read the metadata, the shared strings (on “threads” threads) and the styles of a workbook.
+WorkbookData
+get_workbook_data(zip_t* archive_ptr, Monitor* monitor, unsigned threads);
+WorkbookData
+get_workbook_data(zip_t* archive_ptr, Monitor* monitor);
+WorkbookData
+get_workbook_data(zip_t* archive_ptr);
+Sheet
+get_sheet(WorkbookData const& data, char const* const sheet_name);
+Sheet
+get_sheet(zip_t* archive_ptr, char const* const sheet_name);
+// Get the parts to read for the requested sheet of the workbook “xlsx_file_name” opened as
+// “archive_ptr”, from the cache if “options.cache”.
+Sheet
+get_sheet(zip_t* archive_ptr,
+          str_t const& xlsx_file_name,
+          char const* const sheet_name,
+          Options const& options,
+          Monitor& monitor);
+Sheet
+get_sheet(zip_t* archive_ptr,
+          str_t const& xlsx_file_name,
+          char const* const sheet_name,
+          Options const& options);
+void
+parse_sheet(zip_t* archive_ptr,
+            Sheet const& sheet,
+            Options const& options,
+            cell_callback_t const& callback,
+            Monitor& monitor);
+void
+parse_sheet(zip_t* archive_ptr,
+            Sheet const& sheet,
+            Options const& options,
+            cell_callback_t const& callback);
+// Give all the cells of a sheet to the callback without building a table. Returns the sheet name.
+str_t
+read_cells(char const* const xlsx_file_name,
+           char const* const sheet_name,
+           Options const& options,
+           cell_callback_t const& callback);
+str_t
+read_cells(char const* const xlsx_file_name,
+           char const* const sheet_name,
+           cell_callback_t const& callback);
 // Read a sheet and returns a table (vectors of vectors) of variants.
+// Read a sheet of an opened workbook.
+table_t
+get_table(zip_t* archive_ptr, Sheet const& sheet, Options const& options, Monitor& monitor);
+// Same as get_table for a sheet without its shared strings: their cells are left empty and their
+// row, column and index are appended to “shared”.
+table_t
+get_table(zip_t* archive_ptr,
+          Sheet const& sheet,
+          Options const& options,
+          Monitor& monitor,
+          std::vector<std::array<size_t, 3>>& shared);
+// Read a sheet while its shared strings are decoded on other threads (“options.threads”), with
+// their own handle of the archive; the cells of the shared strings are resolved at the end.
+std::pair<table_t, str_t>
+get_table_concurrent(zip_t* archive_ptr,
+                     char const* const xlsx_file_name,
+                     char const* const sheet_name,
+                     Options const& options,
+                     Monitor& monitor);
+table_t
+get_table(zip_t* archive_ptr, Sheet const& sheet, Options const& options);
+std::pair<table_t, str_t>
+get_table_sheetname(char const* const xlsx_file_name,
+                    char const* const sheet_name,
+                    Options const& options);
 std::pair<table_t, str_t>
 get_table_sheetname(char const* const xlsx_file_name, char const* const sheet_name);
 std::pair<table_t, str_t>
 get_table_sheetname(char const* const xlsx_file_name);
 table_t
+read(char const* const xlsx_file_name, char const* const sheet_name, Options const& options);
+table_t
 read(char const* const xlsx_file_name, char const* const sheet_name);
 table_t
 read(char const* const xlsx_file_name);
@@ -77,9 +592,400 @@ read(char const* const xlsx_file_name);
 std::vector<str_t>
 get_worksheet_names(char const* const xlsx_file_name);
 table_t
+read(str_t const& xlsx_file_name, char const* const sheet_name, Options const& options);
+table_t
 read(str_t const& xlsx_file_name, char const* const sheet_name);
 table_t
 read(str_t const& xlsx_file_name);
+
+// A predicate on a column of a query: a value (equality) or a range (bounds included) on the
+// numbers (int64_t and double are compared as numbers) or on the strings. A missing cell, or a
+// cell of the other type, does not satisfy the predicate.
+struct Predicate
+{
+	size_t column;
+	std::optional<cell_t> min;
+	std::optional<cell_t> max;
+};
+Predicate
+equal(str_t const& column, cell_t const& value);
+Predicate
+between(str_t const& column, cell_t const& min, cell_t const& max);
+Predicate
+at_least(str_t const& column, cell_t const& min);
+Predicate
+at_most(str_t const& column, cell_t const& max);
+
+enum class aggregate_t
+{
+	count,
+	sum,
+	min,
+	max,
+};
+// An aggregate of a query: the count of the rows or the sum, the min or the max of the numbers of
+// a column (the other cells are ignored).
+struct Aggregate
+{
+	aggregate_t op;
+	size_t column;
+};
+Aggregate
+aggregate(aggregate_t op, str_t const& column);
+
+// A query evaluated while the sheet is parsed: the rows (from “first_row”, 0 based) satisfying
+// all the predicates are aggregated, by group if “group_by” is a column. The rows are never
+// stored and the cells of a rejected row are no more converted.
+struct Query
+{
+	std::vector<Predicate> where;
+	std::vector<Aggregate> select;
+	std::optional<size_t> group_by;
+	size_t first_row{ 0 };
+};
+// Result of a query: the values of the aggregates by group (a single group with an empty string as
+// key without “group_by”). The min and max of a group without numbers are NaN.
+typedef std::map<cell_t, std::vector<double>> query_result_t;
+query_result_t
+query(char const* const xlsx_file_name,
+      char const* const sheet_name,
+      Query const& q,
+      Options const& options);
+query_result_t
+query(char const* const xlsx_file_name, char const* const sheet_name, Query const& q);
+
+// Hash index of the rows of a sheet by the values of a key column, with open addressing (linear
+// probing): the strings as they are and the numbers as by get_num (an int64_t and a double of the
+// same value are the same key). The empty cells are not indexed. The rows are the indexes of the
+// rows in the table.
+class KeyIndex
+{
+public:
+	// Index the column “column” (as “B”; an Exception if it is not a column reference) of the rows
+	// of a table from the row “first_row”.
+	KeyIndex(table_t const& table, str_t const& column, size_t first_row);
+	// Index the column of a sheet while it is parsed, without building its table.
+	KeyIndex(char const* const xlsx_file_name,
+	         char const* const sheet_name,
+	         str_t const& column,
+	         size_t first_row,
+	         Options const& options);
+	KeyIndex(char const* const xlsx_file_name,
+	         char const* const sheet_name,
+	         str_t const& column,
+	         size_t first_row);
+	// The first row of the key.
+	std::optional<size_t> find(cell_t const& key) const;
+	// The rows of the key, in the order of the sheet.
+	std::vector<size_t> rows(cell_t const& key) const;
+	size_t count(cell_t const& key) const;
+	// The keys found on several rows, in the order of their first rows.
+	std::vector<cell_t> duplicates() const;
+	bool unique() const { return duplicates_ == 0; }
+	// The count of distinct keys.
+	size_t size() const { return keys_.size(); }
+
+private:
+	// A distinct key: a number or the string “str” of the strings (npos for a number), its hash and
+	// its rows [first, last) in “rows_”.
+	struct Key
+	{
+		uint64_t hash;
+		double num;
+		size_t str;
+		size_t first, last;
+	};
+	// A normalized cell.
+	struct Probe
+	{
+		bool string;
+		double num;
+		std::string_view str;
+		uint64_t hash;
+	};
+	// False for an empty cell.
+	static bool probe(cell_t const& cell, Probe& p);
+	// The slot holding the key of the probe or the empty slot ending its probe sequence.
+	size_t slot(Probe const& p) const;
+	Key const* lookup(cell_t const& key) const;
+	// Add the row “i” to the key of the cell: “entries” are the key and the row of each cell added,
+	// sorted by key into “rows_” by build.
+	void insert(size_t i, cell_t const& cell, std::vector<std::pair<uint32_t, size_t>>& entries);
+	void build(std::vector<std::pair<uint32_t, size_t>> const& entries);
+	std::vector<Key> keys_;
+	SharedStrings strings_;
+	std::vector<size_t> rows_;
+	// The index of a key plus one in each slot (0 for an empty slot); a power of two of slots.
+	std::vector<uint32_t> slots_;
+	size_t duplicates_{};
+};
+
+// Export of a table through the Arrow C Data Interface: a struct array with a child array by
+// column, named from the first row if “header” or from the column references otherwise. A column
+// of int64_t is an int64 array, a column of numbers a float64 array and any other column an utf8
+// array (the numbers as by to_string); the empty cells are null. The buffers are owned by the
+// arrays and freed by their release callbacks, so the consumer imports them without copies.
+void
+export_arrow(table_t const& table, bool header, ArrowSchema* schema, ArrowArray* array);
+
+// Reader of a workbook polled for changes. The CRC and the size of each part, stored in the
+// central directory of the archive, are kept from one read to the next one: a sheet is parsed
+// again only if its part changed (or the shared strings or the styles); the other tables are
+// returned as they are.
+class IncrementalReader
+{
+public:
+	IncrementalReader(str_t const& xlsx_file_name, Options const& options);
+	IncrementalReader(str_t const& xlsx_file_name);
+	// Read the workbook and returns the tables of all the sheets by sheet name.
+	std::map<str_t, table_t> const& read();
+	// The sheets parsed by the last read.
+	std::vector<str_t> const& parsed() const { return parsed_; }
+
+private:
+	str_t const xlsx_file_name_;
+	Options const options_;
+	std::map<str_t, std::pair<uint32_t, uint64_t>> crcs_;
+	Workbook wb_;
+	std::shared_ptr<SharedStrings const> shared_strings_;
+	std::shared_ptr<std::vector<style_kind_t> const> styles_;
+	// Part name of each sheet.
+	std::map<str_t, str_t> files_;
+	std::map<str_t, table_t> tables_;
+	std::vector<str_t> parsed_;
+};
+
+// An access point of a deflated worksheet part, as in the zran example of zlib: the state of the
+// inflate at a deflate block boundary (the compressed offset, the unused bits of the previous
+// byte and the last 32 KiB of output) and the first row tag after it (its offset in the
+// uncompressed part and the index of its row).
+struct Checkpoint
+{
+	uint64_t in;
+	int bits;
+	uint64_t out;
+	str_t window;
+	uint64_t offset;
+	size_t row;
+};
+// Index of the access points of a worksheet, built in one pass with an access point every
+// “spacing” rows (at the next deflate block boundary). A range of rows is read by inflating the
+// part from the nearest access point only. Not available for xlsb sheets.
+class SheetIndex
+{
+public:
+	SheetIndex(str_t const& xlsx_file_name,
+	           char const* const sheet_name,
+	           size_t spacing,
+	           Options const& options);
+	SheetIndex(str_t const& xlsx_file_name, char const* const sheet_name, size_t spacing);
+	// Load an index saved by “save” (the part must not have changed since the index was built).
+	static SheetIndex load(str_t const& xlsx_file_name,
+	                       char const* const sheet_name,
+	                       str_t const& index_file_name,
+	                       Options const& options);
+	static SheetIndex load(str_t const& xlsx_file_name,
+	                       char const* const sheet_name,
+	                       str_t const& index_file_name);
+	void save(str_t const& index_file_name) const;
+	// Read the rows [first, first + count) of the sheet: the row “first” is the row 0 of the table.
+	table_t read_rows(size_t first, size_t count) const;
+	std::vector<Checkpoint> const& checkpoints() const { return checkpoints_; }
+
+private:
+	SheetIndex(str_t const& xlsx_file_name, char const* const sheet_name, Options const& options);
+	str_t const xlsx_file_name_;
+	Options const options_;
+	Sheet sheet_;
+	// CRC and size of the part when the index was built.
+	std::pair<uint32_t, uint64_t> crc_;
+	std::vector<Checkpoint> checkpoints_;
+};
+
+// A sheet decoded on demand: the worksheet part is inflated in memory and scanned once for the
+// boundaries of its rows and of their cells (the offsets of the <c> tags); a row is decoded at its
+// first access and kept, a single cell is decoded alone. The limits of the rows, of the columns
+// and of the cells are checked by the scan; the memory limit covers the part and the rows decoded.
+// Not for xlsb sheets.
+class LazyTable
+{
+public:
+	LazyTable(char const* const xlsx_file_name, char const* const sheet_name, Options const& options);
+	LazyTable(char const* const xlsx_file_name, char const* const sheet_name);
+	// The count of rows, as in the table returned by read.
+	size_t size() const { return spans_.empty() ? 0 : spans_.back().row + 1; }
+	bool empty() const { return spans_.empty(); }
+	// The row “i”, decoded at its first access.
+	row_t const& operator[](size_t i);
+	// The cell of the row “i” and of the column “j” (an empty cell if there is no cell), decoded
+	// alone if its row is not decoded.
+	cell_t cell(size_t i, size_t j);
+	// The count of rows decoded.
+	size_t decoded() const { return decoded_; }
+
+private:
+	// A row with cells: its index and its cells [first, last) in “cells_”.
+	struct Span
+	{
+		size_t row;
+		size_t first, last;
+	};
+	// The value of the “r” attribute of the tag beginning at “pos” (empty if none).
+	std::string_view ref(size_t pos) const;
+	// The column (0 based) of the <c> tag beginning at “pos”, from its “r” attribute.
+	size_t column(size_t pos) const;
+	// Parse the range [begin, end) of the part.
+	void parse(size_t begin, size_t end, cell_callback_t const& callback) const;
+	Options const options_;
+	Sheet sheet_;
+	str_t contents_;
+	std::vector<Span> spans_;
+	// The offset of the <c> tag of each cell, the cells of a row being followed by the offset of
+	// the end of the row.
+	std::vector<size_t> cells_;
+	// The rows decoded, by span.
+	std::vector<std::unique_ptr<row_t const>> rows_;
+	size_t decoded_{};
+	// The bytes charged to the memory limit: the part, its boundaries and the rows decoded.
+	uint64_t memory_{};
+};
+
+// A table in a POSIX shared memory object, with a position independent layout: a header, the
+// index of the first cell of each row (and the count of cells), the cells and the string pool. A
+// string cell holds the offset and the size of its string in the pool.
+struct SharedHeader
+{
+	char magic[8];
+	uint64_t rows;
+	uint64_t cells;
+	uint64_t pool;
+};
+struct SharedCellRecord
+{
+	// The string offset, the int64_t or the bits of the double.
+	uint64_t value;
+	uint32_t size;
+	// The index of the alternative of the cell_t.
+	uint32_t index;
+};
+// A cell of a shared table, with the accessors of a cell_t (the strings are views of the pool).
+struct SharedCell
+{
+	SharedCellRecord const* record;
+	char const* pool;
+};
+// A row of a shared table, with the accessors of a row_t.
+class SharedRow
+{
+public:
+	SharedRow(SharedCellRecord const* first, size_t size, char const* pool)
+	  : first_(first)
+	  , size_(size)
+	  , pool_(pool)
+	{}
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	SharedCell operator[](size_t j) const { return { first_ + j, pool_ }; }
+
+private:
+	SharedCellRecord const* first_;
+	size_t size_;
+	char const* pool_;
+};
+// A table published once in shared memory and attached read-only by other processes.
+class SharedTable
+{
+public:
+	// Publish a table in the shared memory object “name” (“/name” as for shm_open), replacing the
+	// previous one. The processes still attached to the previous one keep it.
+	static void publish(str_t const& name, table_t const& table);
+	static void publish(str_t const& name,
+	                    char const* const xlsx_file_name,
+	                    char const* const sheet_name,
+	                    Options const& options);
+	static void unlink(str_t const& name);
+	// Attach the table published as “name”.
+	explicit SharedTable(str_t const& name);
+	SharedTable(SharedTable const&) = delete;
+	SharedTable& operator=(SharedTable const&) = delete;
+	~SharedTable();
+	size_t size() const { return size_t(header_->rows); }
+	bool empty() const { return header_->rows == 0; }
+	SharedRow operator[](size_t i) const
+	{
+		return { cells_ + rows_[i], size_t(rows_[i + 1] - rows_[i]), pool_ };
+	}
+
+private:
+	void const* address_;
+	size_t length_;
+	SharedHeader const* header_;
+	uint64_t const* rows_;
+	SharedCellRecord const* cells_;
+	char const* pool_;
+};
+bool
+empty(SharedCell const& cell);
+bool inline empty(SharedRow const& v, size_t j)
+{
+	return (j >= v.size()) || empty(v[j]);
+}
+bool
+holds_string(SharedCell const& cell);
+bool inline holds_string(SharedRow const& v, size_t j)
+{
+	return (j < v.size()) && holds_string(v[j]);
+}
+std::string_view
+get_string(SharedCell const& cell);
+bool
+holds_int(SharedCell const& cell);
+bool inline holds_int(SharedRow const& v, size_t j)
+{
+	return (j < v.size()) && holds_int(v[j]);
+}
+int64_t
+get_int(SharedCell const& cell);
+bool
+holds_double(SharedCell const& cell);
+bool inline holds_double(SharedRow const& v, size_t j)
+{
+	return (j < v.size()) && holds_double(v[j]);
+}
+double
+get_double(SharedCell const& cell);
+bool inline holds_num(SharedCell const& cell)
+{
+	return holds_int(cell) || holds_double(cell);
+}
+bool inline holds_num(SharedRow const& v, size_t j)
+{
+	return (j < v.size()) && holds_num(v[j]);
+}
+double
+get_num(SharedCell const& cell);
+cell_t
+to_cell(SharedCell const& cell);
+str_t
+to_string(SharedCell const& cell);
+// As compare of a cell_t; the strings are compared as views of the pool.
+template<typename T>
+bool
+compare(SharedCell const& cell, T const& t)
+{
+	if constexpr (std::is_same_v<T, int64_t>)
+		return holds_int(cell) && (get_int(cell) == t);
+	else if constexpr (std::is_same_v<T, double>)
+		return holds_double(cell) && (get_double(cell) == t);
+	else
+		return holds_string(cell) && (get_string(cell) == std::string_view{ t });
+}
+template<typename T>
+bool inline compare(SharedRow const& v, size_t j, T const& t)
+{
+	return (j < v.size()) && compare(v[j], t);
+}
+
 std::map<std::string, size_t>
 names(row_t const& v);
 template<typename T>
@@ -137,5 +1043,261 @@ double
 get_num(cell_t const& cell);
 str_t
 to_string(cell_t const& cell);
+// A number is an int64_t if it has no fractional part.
+cell_t
+get_number(double d);
+cell_t
+to_cell(cell_view_t const& v);
+// True if “column” is a column reference as “B” or “AC”.
+bool
+is_column_ref(str_t const& column);
+// Index (0 based) of a column reference (an Exception if “column” is not a column reference).
+size_t
+column_index(str_t const& column);
+// Column reference of an index (0 based).
+str_t
+column_ref(size_t j);
+
+template<typename T>
+struct is_optional : std::false_type
+{};
+template<typename T>
+struct is_optional<std::optional<T>> : std::true_type
+{};
+// Convert a decoded cell into the static type of a field: cell_t, str_t, an arithmetic type or a
+// std::optional of one of them (empty if the cell is missing).
+template<typename M>
+void
+convert(cell_view_t const& v, M& m)
+{
+	if constexpr (std::is_same_v<M, cell_t>)
+		m = to_cell(v);
+	else if constexpr (std::is_same_v<M, str_t>) {
+		// The text of a number is kept as it is written; a double is written as the shortest text
+		// read back as the same value.
+		if ((v.kind == cell_view_t::kind_t::string) || (v.kind == cell_view_t::kind_t::text))
+			m = str_t{ v.str };
+		else if (v.kind == cell_view_t::kind_t::real) {
+			char buffer[32];
+			m.assign(buffer, std::to_chars(buffer, buffer + sizeof(buffer), v.real).ptr);
+		} else
+			m = to_string(to_cell(v));
+	}
+	else if constexpr (is_optional<M>::value)
+		convert(v, m.emplace());
+	else {
+		static_assert(std::is_arithmetic_v<M>, "unsupported field type");
+		auto const not_a_number{ [&]() {
+			return Exception{ "the cell “" + str_t{ v.str } + "” is not a number" };
+		} };
+		auto const out_of_range{ [](str_t const& value) {
+			return Exception{ "the cell “" + value + "” is out of the range of the field" };
+		} };
+		auto constexpr integral{ std::is_integral_v<M> && !std::is_same_v<M, bool> };
+		double d{};
+		switch (v.kind) {
+			case cell_view_t::kind_t::string:
+			case cell_view_t::kind_t::shared:
+				throw not_a_number();
+			case cell_view_t::kind_t::integer:
+				if constexpr (integral) {
+					auto const i{ v.integer };
+					if constexpr (std::is_signed_v<M>) {
+						if ((i < std::numeric_limits<M>::min()) || (i > std::numeric_limits<M>::max()))
+							throw out_of_range(std::to_string(i));
+					} else if ((i < 0) || (uint64_t(i) > std::numeric_limits<M>::max()))
+						throw out_of_range(std::to_string(i));
+					m = M(i);
+					return;
+				}
+				d = double(v.integer);
+				break;
+			case cell_view_t::kind_t::real:
+				d = v.real;
+				break;
+			case cell_view_t::kind_t::text: {
+				auto const end{ v.str.data() + v.str.size() };
+				if constexpr (integral) {
+					auto const [ptr, ec]{ std::from_chars(v.str.data(), end, m) };
+					if ((ec == std::errc{}) && (ptr == end))
+						return;
+					if ((ec == std::errc::result_out_of_range) && (ptr == end))
+						throw out_of_range(str_t{ v.str });
+				}
+				auto const [ptr, ec]{ std::from_chars(v.str.data(), end, d) };
+				if ((ec != std::errc{}) || (ptr != end))
+					throw not_a_number();
+				break;
+			}
+		}
+		if constexpr (integral) {
+			if (std::trunc(d) != d)
+				throw Exception{ "the cell “" + std::to_string(d) + "” is not an integer" };
+			// The integers of M are in [lo, hi), both bounds being exact doubles.
+			auto const hi{ std::ldexp(1., std::numeric_limits<M>::digits) };
+			auto const lo{ std::is_signed_v<M> ? -hi : 0. };
+			if ((d < lo) || (d >= hi))
+				throw out_of_range(std::to_string(d));
+		} else if constexpr (std::is_floating_point_v<M>) {
+			if (std::isfinite(d) && (std::abs(d) > std::numeric_limits<M>::max()))
+				throw out_of_range(std::to_string(d));
+		}
+		m = M(d);
+	}
+}
+// A column read by read_as: a column reference (“B”) or a header name of the first row. A string
+// of 1 to 3 capital letters is a reference; a header name as “ID” or “SKU” is given by header().
+struct column_t
+{
+	column_t(str_t const& s)
+	  : name{ s }
+	  , ref{ is_column_ref(s) }
+	{}
+	column_t(char const* s)
+	  : column_t{ str_t{ s } }
+	{}
+	str_t name;
+	bool ref;
+};
+column_t inline header(str_t const& name)
+{
+	column_t rvo{ name };
+	rvo.ref = false;
+	return rvo;
+}
+// A field of an aggregate read by read_as: its column and the pointer to the member.
+template<typename T, typename M>
+struct field_t
+{
+	column_t column;
+	M T::*member;
+	void set(T& t, cell_view_t const& v) const { convert(v, t.*member); }
+};
+template<typename T, typename M>
+field_t<T, M>
+field(column_t const& column, M T::*member)
+{
+	return { column, member };
+}
+// The element K of a tuple read by read_as.
+template<size_t K>
+struct element_t
+{
+	template<typename T>
+	void set(T& t, cell_view_t const& v) const
+	{
+		convert(v, std::get<K>(t));
+	}
+};
+template<size_t... K>
+std::tuple<element_t<K>...> elements(std::index_sequence<K...>)
+{
+	return {};
+}
+// Read a sheet into a vector of T: the field K is set by std::get<K>(fields) from the column
+// columns[K]. The cells are converted directly from their decoded value, without any cell_t.
+template<typename T, typename Fields, size_t... K>
+std::vector<T>
+read_fields(str_t const& xlsx_file_name,
+            str_t const& sheet_name,
+            Options const& options,
+            std::vector<column_t> const& columns,
+            Fields const& fields,
+            std::index_sequence<K...>)
+{
+	auto constexpr npos{ std::numeric_limits<size_t>::max() };
+	std::vector<size_t> index(columns.size(), npos);
+	bool header{};
+	for (size_t k{}; k < columns.size(); ++k)
+		if (columns[k].ref)
+			index[k] = column_index(columns[k].name);
+		else
+			header = true;
+	// The header names are resolved when the first row is read.
+	row_t header_row;
+	auto const resolve{ [&]() {
+		auto const ids{ names(header_row) };
+		for (size_t k{}; k < columns.size(); ++k)
+			if (index[k] == npos) {
+				auto const it{ ids.find(columns[k].name) };
+				if (it == cend(ids))
+					throw Exception{ "the column “" + columns[k].name + "” is not in the first row" };
+				index[k] = it->second;
+			}
+		header = false;
+	} };
+
+	std::vector<T> rvo;
+	auto current{ npos };
+	auto const callback{ [&](size_t i, size_t j, cell_view_t const& v) {
+		if (header) {
+			if (i == 0) {
+				header_row.resize(j);
+				header_row.emplace_back(to_cell(v));
+				return;
+			}
+			resolve();
+		}
+		if (i != current) {
+			rvo.emplace_back();
+			current = i;
+		}
+		((index[K] == j ? std::get<K>(fields).set(rvo.back(), v) : void()), ...);
+	} };
+	read_cells(xlsx_file_name.c_str(), sheet_name.c_str(), options, callback);
+	if (header)
+		resolve();
+	return rvo;
+}
+// Read a sheet into a vector of tuples: the element k of a tuple is read from the column
+// columns[k], given as a column reference (“B”) or as a header name in the first row (which is
+// then skipped). Example:
+//   auto const v{ read_as<std::tuple<str_t, double>>("file.xlsx", "", { "A", header("SKU") }) };
+// Rows without any cell are skipped; missing cells let the elements with their default value. The
+// options (limits, cancellation, ISO dates) are given after the sheet name.
+template<typename T>
+std::vector<T>
+read_as(str_t const& xlsx_file_name,
+        str_t const& sheet_name,
+        Options const& options,
+        std::array<column_t, std::tuple_size<T>::value> const& columns)
+{
+	return read_fields<T>(xlsx_file_name,
+	                      sheet_name,
+	                      options,
+	                      std::vector<column_t>(cbegin(columns), cend(columns)),
+	                      elements(std::make_index_sequence<std::tuple_size<T>::value>{}),
+	                      std::make_index_sequence<std::tuple_size<T>::value>{});
+}
+template<typename T>
+std::vector<T>
+read_as(str_t const& xlsx_file_name,
+        str_t const& sheet_name,
+        std::array<column_t, std::tuple_size<T>::value> const& columns)
+{
+	return read_as<T>(xlsx_file_name, sheet_name, Options{}, columns);
+}
+// Same for an aggregate, with a field per member:
+//   auto const v{ read_as<Product>("file.xlsx", "", field("A", &Product::code)) };
+template<typename T, typename... Ms>
+std::vector<T>
+read_as(str_t const& xlsx_file_name,
+        str_t const& sheet_name,
+        Options const& options,
+        field_t<T, Ms> const&... fields)
+{
+	return read_fields<T>(xlsx_file_name,
+	                      sheet_name,
+	                      options,
+	                      { fields.column... },
+	                      std::tuple{ fields... },
+	                      std::index_sequence_for<Ms...>{});
+}
+template<typename T, typename... Ms>
+std::vector<T>
+read_as(str_t const& xlsx_file_name, str_t const& sheet_name, field_t<T, Ms> const&... fields)
+{
+	return read_as<T>(xlsx_file_name, sheet_name, Options{}, fields...);
+}
 } // namespace fd_read_xlsx
 #endif // FD_READ_XLSX_HPP
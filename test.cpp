@@ -1,5 +1,44 @@
 #include "fd-read-xlsx.hpp"
 #include <cassert>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+struct Row
+{
+	double b;
+	int64_t c;
+	std::optional<fd_read_xlsx::str_t> d;
+};
+
+// True if the read of “file_name” with the limits throws the exception “E”.
+template<typename E>
+bool
+throws(char const* const file_name, fd_read_xlsx::Limits const& limits)
+{
+	fd_read_xlsx::Options options;
+	options.limits = limits;
+	try {
+		fd_read_xlsx::read(file_name, "", options);
+	} catch (E const&) {
+		return true;
+	}
+	return false;
+}
+
+// True if the cell “v” is converted into a field of type “M”.
+template<typename M>
+bool
+converts(fd_read_xlsx::cell_view_t const& v)
+{
+	M m;
+	try {
+		fd_read_xlsx::convert(v, m);
+	} catch (fd_read_xlsx::Exception const&) {
+		return false;
+	}
+	return true;
+}
 
 int
 main()
@@ -24,6 +63,365 @@ main()
 	assert(fd_read_xlsx::holds_num(table[1][0]) && fd_read_xlsx::holds_num(table[2][0]));
 	// The namespace defines “get_num" which returns a double.
 	assert(fd_read_xlsx::get_num(table[1][0]) == 1.);
+	// A xlsb workbook (the same contents in BIFF12 records) is read with the same function.
+	assert(fd_read_xlsx::read("test.xlsb") == table);
+	assert(fd_read_xlsx::get_worksheet_names("test.xlsb") ==
+	       fd_read_xlsx::get_worksheet_names("test.xlsx"));
+
+	// The entities are decoded: the predefined ones and the character references; an unknown
+	// entity or an invalid reference is kept as it is.
+	assert(fd_read_xlsx::decode_entities("a &amp; b&lt;&#x41;&#66;") == "a & b<AB");
+	assert(fd_read_xlsx::decode_entities("&nbsp;&#x110000;&#;&x41;") == "&nbsp;&#x110000;&#;&x41;");
+	fd_read_xlsx::str_t entities;
+	fd_read_xlsx::append_entity(entities, "#x20AC");
+	fd_read_xlsx::append_entity(entities, "quot");
+	fd_read_xlsx::append_entity(entities, "#12z");
+	assert(entities == "\xe2\x82\xac\"&#12z;");
+	// The rich text runs of a shared string are concatenated, its phonetic runs skipped.
+	assert((fd_read_xlsx::read("test-rich.xlsx") ==
+	        fd_read_xlsx::table_t{ { "Fish & chips", "AB<&nbsp;&#x110000;", "in & out" } }));
+
+	// A read error of a part (corrupted deflate data) is not the end of the part.
+	assert(throws<fd_read_xlsx::Exception>("test-corrupted.xlsx", {}));
+	assert(throws<fd_read_xlsx::Exception>("test-corrupted.xlsb", {}));
+
+	// Number formats of the styles and conversion of the serial dates.
+	using fd_read_xlsx::style_kind_t;
+	assert(fd_read_xlsx::get_format_kind(14, "") == style_kind_t::date);
+	assert(fd_read_xlsx::get_format_kind(164, "yyyy\\-mm\\-dd\\ hh:mm") == style_kind_t::datetime);
+	assert(fd_read_xlsx::get_format_kind(165, "[h]:mm") == style_kind_t::elapsed);
+	assert(fd_read_xlsx::get_format_kind(20, "") == style_kind_t::time);
+	assert(fd_read_xlsx::get_format_kind(166, "[Red]0.00%") == style_kind_t::percent);
+	assert(fd_read_xlsx::get_format_kind(167, "\"d\"0.00") == style_kind_t::number);
+	assert(fd_read_xlsx::serial_to_iso(43980.79236111111, style_kind_t::datetime, false) ==
+	       "2020-05-29T19:01:00");
+	assert(fd_read_xlsx::serial_to_iso(1, style_kind_t::date, false) == "1900-01-01");
+	assert(fd_read_xlsx::serial_to_iso(0, style_kind_t::date, true) == "1904-01-01");
+	assert(fd_read_xlsx::serial_to_iso(1.5, style_kind_t::elapsed, false) == "36:00:00");
+	// A time of the day drops the days of a datetime serial.
+	assert(fd_read_xlsx::serial_to_iso(43980.79236111111, style_kind_t::time, false) == "19:01:00");
+	// The built-in formats 20 (“h:mm”, a time of the day) and 46 (“[h]:mm:ss”, an elapsed time).
+	assert((fd_read_xlsx::read("test-times.xlsx", "", fd_read_xlsx::Options{ true }) ==
+	        fd_read_xlsx::table_t{ { "19:01:00", "36:00:00" } }));
+	// No date style in “test.xlsx”: the option does not change the numbers.
+	assert(fd_read_xlsx::read("test.xlsx", "", fd_read_xlsx::Options{ true }) == table);
+
+	// Only the changed sheets are parsed again.
+	fd_read_xlsx::IncrementalReader reader{ "test.xlsx" };
+	assert(reader.read().at("test.gnumeric") == table);
+	assert(reader.parsed().size() == 1);
+	assert(reader.read().at("test.gnumeric") == table);
+	assert(reader.parsed().empty());
+
+	// The cells are decoded directly into tuples or aggregates, from column references or header
+	// names (then the first row is skipped).
+	auto const tuples{ fd_read_xlsx::read_as<std::tuple<double, double, std::optional<int>>>(
+	  "test.xlsx", "", { "b", "A", "D" }) };
+	assert((tuples == std::vector<std::tuple<double, double, std::optional<int>>>{
+	                    { 2., 1., std::nullopt }, { 2.2, 1.1, std::nullopt } }));
+	auto const rows{ fd_read_xlsx::read_as<Row>("test.xlsb",
+	                                            "",
+	                                            fd_read_xlsx::field("b", &Row::b),
+	                                            fd_read_xlsx::field("D", &Row::d)) };
+	assert((rows.size() == 2) && (rows[1].b == 2.2) && !rows[1].d);
+	// With the options of the read: its limits, its cancellation and its deadline.
+	fd_read_xlsx::Options one_row;
+	one_row.limits.rows = 1;
+	try {
+		fd_read_xlsx::read_as<Row>("test.xlsx", "", one_row, fd_read_xlsx::field("b", &Row::b));
+		assert(false);
+	} catch (fd_read_xlsx::RowsLimitExceeded const&) {
+	}
+	// A header name of capital letters is told from a column reference by header().
+	assert(fd_read_xlsx::column_t{ "SKU" }.ref && !fd_read_xlsx::header("SKU").ref);
+	assert((fd_read_xlsx::read_as<std::tuple<double>>("test.xlsx", "", { fd_read_xlsx::header("b") })
+	        == std::vector<std::tuple<double>>{ { 2. }, { 2.2 } }));
+	try {
+		fd_read_xlsx::read_as<Row>(
+		  "test.xlsx", "", fd_read_xlsx::field(fd_read_xlsx::header("B"), &Row::b));
+		assert(false);
+	} catch (fd_read_xlsx::Exception const&) {
+	}
+	try {
+		fd_read_xlsx::read_as<Row>("test.xlsx", "", fd_read_xlsx::field("C", &Row::c));
+		assert(false);
+	} catch (fd_read_xlsx::Exception const&) {
+	}
+	// The conversions are checked against the range of the fields.
+	using kind_t = fd_read_xlsx::cell_view_t::kind_t;
+	assert(!converts<int>({ kind_t::text, "1e+10", 0, 0., {} }));
+	assert(!converts<unsigned>({ kind_t::text, "-1", 0, 0., {} }));
+	assert(converts<unsigned>({ kind_t::text, "4294967295", 0, 0., {} }));
+	assert(!converts<short>({ kind_t::integer, "", 70000, 0., {} }));
+	assert(converts<short>({ kind_t::integer, "", -7000, 0., {} }));
+	assert(!converts<int64_t>({ kind_t::real, "", 0, 9223372036854775808., {} }));
+	assert(!converts<float>({ kind_t::real, "", 0, 1e300, {} }));
+	// A number read into a string keeps all its digits.
+	fd_read_xlsx::str_t code;
+	fd_read_xlsx::convert({ kind_t::text, "12345.678901", 0, 0., {} }, code);
+	assert(code == "12345.678901");
+	fd_read_xlsx::convert({ kind_t::real, "", 0, 1234567.5, {} }, code);
+	assert(code == "1234567.5");
+
+	// The predicates and the aggregates are evaluated while the sheet is parsed.
+	using fd_read_xlsx::aggregate_t;
+	fd_read_xlsx::Query query;
+	query.where.push_back(fd_read_xlsx::between("A", int64_t{ 1 }, 2.));
+	query.select.push_back(fd_read_xlsx::aggregate(aggregate_t::count, "A"));
+	query.select.push_back(fd_read_xlsx::aggregate(aggregate_t::sum, "C"));
+	query.select.push_back(fd_read_xlsx::aggregate(aggregate_t::max, "B"));
+	auto const result{ fd_read_xlsx::query("test.xlsx", "", query) };
+	assert((result.size() == 1) && (result.at("")[0] == 2.) &&
+	       (std::abs(result.at("")[1] - 6.3) < 1e-9) && (result.at("")[2] == 2.2));
+	query.where = { fd_read_xlsx::at_least("B", int64_t{ 2 }) };
+	query.group_by = fd_read_xlsx::column_index("A");
+	auto const groups{ fd_read_xlsx::query("test.xlsb", "", query) };
+	assert((groups.size() == 2) && (groups.at(int64_t{ 1 })[0] == 1.) &&
+	       (groups.at(1.1)[1] == 3.3));
+	query.where = { fd_read_xlsx::equal("A", "a") };
+	assert(fd_read_xlsx::query("test.xlsx", "", query).at("a")[0] == 1.);
+	// The columns are column references, not header names.
+	for (auto const column : { "price", "" })
+		try {
+			fd_read_xlsx::aggregate(aggregate_t::count, column);
+			assert(false);
+		} catch (fd_read_xlsx::Exception const&) {
+		}
+
+	// Arrow export, read as a C consumer would.
+	ArrowSchema schema;
+	ArrowArray array;
+	fd_read_xlsx::export_arrow(table, true, &schema, &array);
+	assert((std::strcmp(schema.format, "+s") == 0) && (schema.n_children == 3));
+	assert((array.length == 2) && (array.n_children == 3));
+	assert((std::strcmp(schema.children[1]->format, "g") == 0) &&
+	       (std::strcmp(schema.children[1]->name, "b") == 0));
+	auto const reals{ static_cast<double const*>(array.children[1]->buffers[1]) };
+	assert((array.children[1]->null_count == 0) && (reals[0] == 2.) && (reals[1] == 2.2));
+	schema.release(&schema);
+	array.release(&array);
+	assert(!schema.release && !array.release);
+	fd_read_xlsx::export_arrow(
+	  fd_read_xlsx::table_t{ { int64_t{ 1 }, "x" }, {}, { int64_t{ 3 }, 0.1 + 0.2 } },
+	  false,
+	  &schema,
+	  &array);
+	assert((std::strcmp(schema.children[0]->format, "l") == 0) &&
+	       (std::strcmp(schema.children[1]->name, "B") == 0));
+	auto const validity{ static_cast<uint8_t const*>(array.children[0]->buffers[0]) };
+	auto const integers{ static_cast<int64_t const*>(array.children[0]->buffers[1]) };
+	assert((array.children[0]->null_count == 1) && (validity[0] == 0x5) && (integers[2] == 3));
+	auto const offsets{ static_cast<int32_t const*>(array.children[1]->buffers[1]) };
+	auto const chars{ static_cast<char const*>(array.children[1]->buffers[2]) };
+	assert((std::strcmp(schema.children[1]->format, "u") == 0) && (offsets[1] == 1) &&
+	       (offsets[2] == 1) && (chars[0] == 'x'));
+	// The numbers of a string column are written as the shortest text read back as the same value.
+	assert((std::string_view{ chars + 1, size_t(offsets[3] - 1) } == "0.30000000000000004"));
+	schema.release(&schema);
+	array.release(&array);
+
+	// Random access to the rows through an index of the deflate access points.
+	fd_read_xlsx::SheetIndex const index{ "test.xlsx", "", 1 };
+	auto const index_file_name{ (std::filesystem::temp_directory_path() / "test.xlsx.idx").string() };
+	index.save(index_file_name);
+	auto const loaded{ fd_read_xlsx::SheetIndex::load("test.xlsx", "", index_file_name) };
+	std::filesystem::remove(index_file_name);
+	assert(loaded.checkpoints().size() == index.checkpoints().size());
+	assert((loaded.read_rows(1, 1) == fd_read_xlsx::table_t{ table[1] }));
+	assert((loaded.read_rows(0, 10) == table) && loaded.read_rows(3, 10).empty());
+	// Sheets spanning several deflate blocks, deflated and stored (read as it is: the offsets of
+	// its access points in the part and in the sheet are the same).
+	for (auto const& [file_name, stored] :
+	     { std::pair{ "test-blocks.xlsx", false }, std::pair{ "test-blocks-stored.xlsx", true } }) {
+		fd_read_xlsx::SheetIndex const blocks{ file_name, "", 100 };
+		auto const rows{ fd_read_xlsx::read(file_name, "") };
+		assert((rows.size() == 500) && (blocks.checkpoints().size() > 1));
+		for (auto const& point : blocks.checkpoints()) {
+			assert(stored ? (point.in == point.out) : (point.in < point.out));
+			auto const first{ cbegin(rows) + std::ptrdiff_t(point.row - 1) };
+			assert((blocks.read_rows(point.row - 1, 3) == fd_read_xlsx::table_t{ first, first + 3 }));
+		}
+	}
+
+	// With the cache, the metadata and the shared strings are decoded once for all the reads.
+	auto& cache{ fd_read_xlsx::Cache::instance() };
+	fd_read_xlsx::Options cached;
+	cached.cache = true;
+	assert(fd_read_xlsx::read("test.xlsx", "", cached) == table);
+	assert(fd_read_xlsx::read("test.xlsx", "", cached) == table);
+	assert((cache.size() == 1) && (cache.bytes() > 0));
+	// A cache hit is checked against the limits of its own read.
+	cached.limits.memory = 1;
+	try {
+		fd_read_xlsx::read("test.xlsx", "", cached);
+		assert(false);
+	} catch (fd_read_xlsx::MemoryLimitExceeded const&) {
+	}
+	cache.set_budget(0);
+	assert((cache.size() == 0) && (cache.bytes() == 0));
+	// A read waiting for the workbook decoded by another read checks its own deadline.
+	std::atomic<bool> started{}, released{};
+	fd_read_xlsx::Options blocked;
+	blocked.cache = true;
+	blocked.progress = [&](uint64_t, size_t) {
+		started = true;
+		while (!released)
+			std::this_thread::yield();
+	};
+	auto decoding{ std::async(std::launch::async,
+		                        [&]() { return fd_read_xlsx::read("test.xlsx", "", blocked); }) };
+	while (!started)
+		std::this_thread::yield();
+	fd_read_xlsx::Options waiting;
+	waiting.cache = true;
+	waiting.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+	try {
+		fd_read_xlsx::read("test.xlsx", "", waiting);
+		assert(false);
+	} catch (fd_read_xlsx::DeadlineExceeded const&) {
+	}
+	released = true;
+	assert(decoding.get() == table);
+
+	// A table published in shared memory and attached as by another process.
+	auto const shm_name{ "/fd-read-xlsx-test-" + std::to_string(getpid()) };
+	fd_read_xlsx::SharedTable::publish(shm_name, "test.xlsx", "", fd_read_xlsx::Options{});
+	{
+		fd_read_xlsx::SharedTable const shared{ shm_name };
+		fd_read_xlsx::SharedTable::unlink(shm_name);
+		assert((shared.size() == table.size()) && (shared[0].size() == 3));
+		assert(fd_read_xlsx::get_string(shared[0][1]) == "b");
+		assert(fd_read_xlsx::holds_int(shared[1], 2) && (fd_read_xlsx::get_int(shared[1][2]) == 3));
+		assert(fd_read_xlsx::get_num(shared[2][1]) == 2.2);
+		assert(fd_read_xlsx::compare(shared[0][0], "a") && fd_read_xlsx::compare(shared[0], 1, "b"));
+		assert(fd_read_xlsx::compare(shared[0][0], fd_read_xlsx::str_t{ "a" }));
+		assert(fd_read_xlsx::compare(shared[1], 2, int64_t{ 3 }) &&
+		       !fd_read_xlsx::compare(shared[1], 2, 3.));
+		assert(fd_read_xlsx::compare(shared[2][1], 2.2) && !fd_read_xlsx::compare(shared[2], 5, 2.2));
+		for (size_t i{}; i < table.size(); ++i)
+			for (size_t j{}; j < table[i].size(); ++j)
+				assert(fd_read_xlsx::to_cell(shared[i][j]) == table[i][j]);
+	}
+
+	// A read reports its progress and is stopped by its cancellation token or its deadline.
+	fd_read_xlsx::Options monitored;
+	uint64_t inflated{};
+	monitored.progress = [&](uint64_t bytes, size_t) { inflated = bytes; };
+	assert((fd_read_xlsx::read("test.xlsx", "", monitored) == table) && (inflated > 0));
+	auto const cancel{ std::make_shared<std::atomic<bool>>(true) };
+	monitored.cancel = cancel;
+	try {
+		fd_read_xlsx::read("test.xlsb", "", monitored);
+		assert(false);
+	} catch (fd_read_xlsx::Cancelled const&) {
+	}
+	cancel->store(false);
+	monitored.deadline = std::chrono::steady_clock::now();
+	try {
+		fd_read_xlsx::read("test.xlsx", "", monitored);
+		assert(false);
+	} catch (fd_read_xlsx::DeadlineExceeded const&) {
+	}
+
+	// Limits: uncompressed bytes, compression ratio, rows, columns, cells, shared strings, memory.
+	fd_read_xlsx::Options limited;
+	limited.limits = { 1 << 20, 100., 3, 3, 9, 1 << 10, 1 << 20 };
+	assert(fd_read_xlsx::read("test.xlsx", "", limited) == table);
+	fd_read_xlsx::Options limited_memory, limited_rows;
+	limited_memory.limits.memory = 1;
+	limited_rows.limits.rows = 2;
+	assert(throws<fd_read_xlsx::UncompressedSizeExceeded>("test.xlsx", { 100, 0, 0, 0, 0, 0, 0 }));
+	assert(throws<fd_read_xlsx::CompressionRatioExceeded>("test.xlsx", { 0, 1.5, 0, 0, 0, 0, 0 }));
+	assert(throws<fd_read_xlsx::RowsLimitExceeded>("test.xlsb", { 0, 0, 2, 0, 0, 0, 0 }));
+	assert(throws<fd_read_xlsx::ColumnsLimitExceeded>("test.xlsx", { 0, 0, 0, 2, 0, 0, 0 }));
+	assert(throws<fd_read_xlsx::CellsLimitExceeded>("test.xlsx", { 0, 0, 0, 0, 8, 0, 0 }));
+	assert(throws<fd_read_xlsx::MemoryLimitExceeded>("test.xlsx", { 0, 0, 0, 0, 0, 0, 1 }));
+	try {
+		fd_read_xlsx::IncrementalReader{ "test.xlsx", limited_memory }.read();
+		assert(false);
+	} catch (fd_read_xlsx::MemoryLimitExceeded const&) {
+	}
+	try {
+		fd_read_xlsx::SheetIndex{ "test.xlsx", "", 1, limited_rows };
+		assert(false);
+	} catch (fd_read_xlsx::RowsLimitExceeded const&) {
+	}
+
+	// The shared strings decoded on several threads, while the worksheet is parsed.
+	fd_read_xlsx::Options threaded;
+	threaded.threads = 4;
+	assert(fd_read_xlsx::read("test.xlsx", "", threaded) == table);
+	assert(fd_read_xlsx::read("test.xlsb", "", threaded) == table);
+	threaded.limits = limited.limits;
+	assert(fd_read_xlsx::read("test.xlsx", "", threaded) == table);
+	// A failed parse of the worksheet stops the decode of the shared strings.
+	threaded.limits = limited_rows.limits;
+	try {
+		fd_read_xlsx::read("test.xlsx", "", threaded);
+		assert(false);
+	} catch (fd_read_xlsx::RowsLimitExceeded const&) {
+	}
+
+	// Hash index of the rows by a key column, the numbers being normalized.
+	fd_read_xlsx::KeyIndex const keys{ "test.xlsx", "", "C", 1 };
+	assert((keys.size() == 2) && keys.unique() && (keys.find(int64_t{ 3 }) == 1));
+	assert((keys.find(3.) == 1) && (keys.find(3.3) == 2) && !keys.find(fd_read_xlsx::str_t{ "a" }));
+	fd_read_xlsx::table_t const codes{ { "x" }, { int64_t{ 1 } }, { 1. }, { "x" }, { "" } };
+	fd_read_xlsx::KeyIndex const duplicated{ codes, "A", 0 };
+	assert((duplicated.size() == 2) && !duplicated.unique() && (duplicated.count(-0.) == 0));
+	assert((duplicated.rows(fd_read_xlsx::str_t{ "x" }) == std::vector<size_t>{ 0, 3 }));
+	assert((duplicated.duplicates() == std::vector<fd_read_xlsx::cell_t>{ "x", int64_t{ 1 } }));
+	try {
+		fd_read_xlsx::KeyIndex{ "test.xlsx", "", "code", 1 };
+		assert(false);
+	} catch (fd_read_xlsx::Exception const&) {
+	}
+
+	// A table decoded on demand, by row or by cell.
+	fd_read_xlsx::LazyTable lazy{ "test.xlsx", "" };
+	assert((lazy.size() == table.size()) && (lazy.decoded() == 0));
+	assert((lazy.cell(2, 1) == table[2][1]) && (lazy.cell(2, 5) == fd_read_xlsx::cell_t{}));
+	assert((lazy.decoded() == 0) && (lazy[1] == table[1]) && (lazy.decoded() == 1));
+	for (size_t i{}; i < table.size(); ++i)
+		assert(lazy[i] == table[i]);
+	assert(lazy[table.size()].empty() && (lazy.cell(1, 2) == table[1][2]));
+	// The limits of the rows, of the columns and of the cells are checked by the scan.
+	assert(fd_read_xlsx::LazyTable("test.xlsx", "", limited).size() == table.size());
+	try {
+		fd_read_xlsx::LazyTable{ "test.xlsx", "", limited_rows };
+		assert(false);
+	} catch (fd_read_xlsx::RowsLimitExceeded const&) {
+	}
+	fd_read_xlsx::Options limited_columns;
+	limited_columns.limits.columns = 2;
+	try {
+		fd_read_xlsx::LazyTable{ "test.xlsx", "", limited_columns };
+		assert(false);
+	} catch (fd_read_xlsx::ColumnsLimitExceeded const&) {
+	}
+	// A cell without reference is rejected by the scan, as by read.
+	assert(throws<fd_read_xlsx::Exception>("test-no-ref.xlsx", {}));
+	try {
+		fd_read_xlsx::LazyTable{ "test-no-ref.xlsx", "" };
+		assert(false);
+	} catch (fd_read_xlsx::Exception const&) {
+	}
+	// The memory limit covers the part (2022 bytes) and the rows decoded.
+	fd_read_xlsx::Options lazy_memory;
+	for (lazy_memory.limits.memory = 64;; lazy_memory.limits.memory += 64)
+		try {
+			fd_read_xlsx::LazyTable{ "test.xlsx", "", lazy_memory };
+			break;
+		} catch (fd_read_xlsx::MemoryLimitExceeded const&) {
+		}
+	assert(lazy_memory.limits.memory > 2022);
+	fd_read_xlsx::LazyTable lazy_limited{ "test.xlsx", "", lazy_memory };
+	try {
+		for (size_t i{}; i < lazy_limited.size(); ++i)
+			lazy_limited[i];
+		assert(false);
+	} catch (fd_read_xlsx::MemoryLimitExceeded const&) {
+	}
 
 	return 0;
 }